@@ -0,0 +1,94 @@
+// Randomized check of ClientTable against std::map, exercising the hash
+// table's backward-shift deletion with long probe sequences.
+//
+// Usage: client_table_check [operations=200000] [seed=1]
+//
+// Inserts and erases clients with window IDs drawn from a small range, so that
+// slots and IDs are reused and the table grows and churns, and checks
+// regularly that lookups by client and by frame window, and iteration, agree
+// with the reference. Exits with a failure status on the first mismatch.
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include "../client_table.hpp"
+
+namespace {
+
+// Window IDs are drawn from this many values, spaced like the resource IDs of
+// one X client.
+const int WINDOW_RANGE = 3000;
+const Window CLIENT_BASE = 0x400000;
+// Frames get IDs of their own, as ours are allocated by our connection.
+const Window FRAME_BASE = 0x800000;
+
+bool Fail(const char* what, Window w) {
+  fprintf(stderr, "Mismatch: %s for window 0x%lx\n", what, w);
+  return false;
+}
+
+// Checks that every window of the range is found exactly as in reference.
+bool CheckAll(
+    ClientTable* table, const ::std::map<Window, const Client*>& reference) {
+  for (int i = 0; i < WINDOW_RANGE; ++i) {
+    const Window w = CLIENT_BASE + i * 4;
+    auto j = reference.find(w);
+    const Client* expected = j != reference.end() ? j->second : nullptr;
+    if (table->Find(w) != expected) {
+      return Fail("Find", w);
+    }
+    if (table->FindByFrame(FRAME_BASE + w) != expected) {
+      return Fail("FindByFrame", w);
+    }
+    // Client and frame windows must not be confused.
+    if (table->Find(FRAME_BASE + w) != nullptr ||
+        table->FindByFrame(w) != nullptr) {
+      return Fail("lookup of the wrong kind", w);
+    }
+  }
+  size_t n = 0;
+  for (const Client& c : *table) {
+    if (!reference.count(c.window)) {
+      return Fail("iteration", c.window);
+    }
+    ++n;
+  }
+  if (n != reference.size() || table->size() != reference.size()) {
+    return Fail("size", None);
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const int operations = argc > 1 ? atoi(argv[1]) : 200000;
+  ::std::mt19937 random(argc > 2 ? atoi(argv[2]) : 1);
+  ClientTable table;
+  // Records are expected to stay at the address Insert() returned.
+  ::std::map<Window, const Client*> reference;
+  for (int i = 0; i < operations; ++i) {
+    // 1. Erase the window if it is there, or add it.
+    const Window w = CLIENT_BASE + random() % WINDOW_RANGE * 4;
+    Client* c = table.Find(w);
+    if (c != nullptr) {
+      table.Erase(c);
+      reference.erase(w);
+    } else {
+      c = table.Insert(w);
+      c->frame = FRAME_BASE + w;
+      table.IndexFrame(c);
+      reference[w] = c;
+      if (table.Get(table.HandleOf(c)) != c) {
+        Fail("handle", w);
+        return EXIT_FAILURE;
+      }
+    }
+    // 2. Compare everything now and then, as that is slow.
+    if ((i % 997 == 0 || i == operations - 1) && !CheckAll(&table, reference)) {
+      return EXIT_FAILURE;
+    }
+  }
+  printf("%d operations, %zu clients left: ok\n", operations, table.size());
+  return EXIT_SUCCESS;
+}
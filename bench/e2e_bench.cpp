@@ -0,0 +1,295 @@
+// End-to-end latency benchmark, driving a running basic_wm the way a user
+// would, and timing how long it takes for the effects to reach clients.
+//
+// Usage: e2e_bench <IPC socket> <x_proxy counters file> [clients] [iterations]
+//
+// Connects to $DISPLAY directly, while basic_wm is expected to be connected
+// through x_proxy, so that the protocol counts are those of the window manager
+// alone. Maps the given number of dummy clients, then repeats a scripted
+// sequence of operations, and reports percentiles of the latency from input
+// to the last resulting event, and the X traffic each operation caused.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+extern "C" {
+#include <X11/Xlibint.h>
+#include <X11/Xatom.h>
+#include <X11/extensions/xtestproto.h>
+#include <X11/keysym.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+}
+// Xlibint.h defines these as macros, which break the standard library.
+#undef min
+#undef max
+#include "x_proxy.hpp"
+
+using ::std::string;
+using ::std::vector;
+typedef ::std::chrono::steady_clock Clock;
+
+namespace {
+
+// How long no relevant events must arrive for an operation to be finished.
+const int QUIET_MS = 30;
+// How long to wait for an operation at most.
+const int TIMEOUT_MS = 2000;
+
+// Latencies and traffic of one kind of operation.
+struct Samples {
+  vector<double> latencies_us;
+  uint64_t requests = 0;
+  uint64_t replies = 0;
+  int timeouts = 0;
+};
+
+class Bench {
+ public:
+  Bench(Display* display, int ipc_fd, const Counters* counters)
+      : display_(display),
+        root_(DefaultRootWindow(display)),
+        ipc_fd_(ipc_fd),
+        counters_(counters),
+        client_list_(XInternAtom(display, "_NET_CLIENT_LIST", false)) {
+    XSelectInput(display_, root_, PropertyChangeMask);
+    int event, error;
+    has_xtest_ = XQueryExtension(
+        display_, "XTEST", &xtest_opcode_, &event, &error);
+  }
+
+  // Maps a window from its own connection and waits until it is framed. The
+  // window can then be killed.
+  Window MapClient(Samples* samples) {
+    Display* display = XOpenDisplay(nullptr);
+    const Window w = XCreateSimpleWindow(
+        display, DefaultRootWindow(display), 0, 0, 200, 200, 0, 0, 0);
+    XSync(display, false);
+    XSelectInput(display_, w, StructureNotifyMask);
+    XSync(display_, false);
+    Measure(samples, PropertyNotify, [&] {
+      XMapWindow(display, w);
+      XFlush(display);
+    });
+    // The connection must not be used again, as the window manager may kill
+    // it, and Xlib exits on I/O errors. Its file descriptor stays open until
+    // then, or we exit.
+    return w;
+  }
+
+  // Sends an IPC command and waits for its reply and effects.
+  void Command(Samples* samples, int event_type, const string& command) {
+    Measure(samples, event_type, [&] {
+      const string line = command + "\n";
+      if (write(ipc_fd_, line.data(), line.size()) < 0) {
+        perror("write");
+        exit(EXIT_FAILURE);
+      }
+      char reply[256];
+      if (read(ipc_fd_, reply, sizeof(reply)) <= 0) {
+        fprintf(stderr, "No reply to %s\n", command.c_str());
+        exit(EXIT_FAILURE);
+      }
+    });
+  }
+
+  // Resizes w with alt + right button drag, in the given number of steps.
+  void Drag(Samples* samples, Window w, int steps) {
+    if (!has_xtest_) {
+      return;
+    }
+    Window child;
+    int x, y;
+    XTranslateCoordinates(display_, w, root_, 10, 10, &x, &y, &child);
+    const int alt = XKeysymToKeycode(display_, XK_Alt_L);
+    FakeInput(MotionNotify, 0, x, y);
+    FakeInput(KeyPress, alt, 0, 0);
+    FakeInput(ButtonPress, Button3, 0, 0);
+    XSync(display_, false);
+    Measure(samples, ConfigureNotify, [&] {
+      for (int i = 1; i <= steps; ++i) {
+        FakeInput(MotionNotify, 0, x + i * (i % 2 ? 4 : -3), y);
+      }
+      FakeInput(ButtonRelease, Button3, 0, 0);
+      XFlush(display_);
+    });
+    FakeInput(KeyRelease, alt, 0, 0);
+    XSync(display_, false);
+  }
+
+  bool has_xtest() const { return has_xtest_; }
+
+ private:
+  // Runs action, then waits until events of the given type stop arriving.
+  // Records the time from the start of action to the last such event, and the
+  // window manager's traffic in the meantime.
+  void Measure(
+      Samples* samples, int event_type, const ::std::function<void()>& action) {
+    const uint64_t requests = counters_->requests;
+    const uint64_t replies = counters_->replies;
+    const Clock::time_point start = Clock::now();
+    action();
+    Clock::time_point last = start;
+    bool seen = false;
+    for (;;) {
+      const Clock::time_point now = Clock::now();
+      const Clock::time_point deadline =
+          seen ? last + ::std::chrono::milliseconds(QUIET_MS)
+               : start + ::std::chrono::milliseconds(TIMEOUT_MS);
+      if (!XPending(display_)) {
+        if (now >= deadline) {
+          break;
+        }
+        pollfd fd = {ConnectionNumber(display_), POLLIN, 0};
+        poll(&fd, 1, ::std::chrono::duration_cast<::std::chrono::milliseconds>(
+            deadline - now).count() + 1);
+        continue;
+      }
+      XEvent e;
+      XNextEvent(display_, &e);
+      if (e.type == event_type &&
+          (e.type != PropertyNotify || e.xproperty.atom == client_list_)) {
+        last = Clock::now();
+        seen = true;
+      }
+    }
+    if (!seen) {
+      ++samples->timeouts;
+      return;
+    }
+    samples->latencies_us.push_back(
+        ::std::chrono::duration<double, ::std::micro>(last - start).count());
+    samples->requests += counters_->requests - requests;
+    samples->replies += counters_->replies - replies;
+  }
+
+  // Sends an XTEST FakeInput request, as libXtst would.
+  void FakeInput(int type, int detail, int x, int y) {
+    // The Xlibint.h macros expect the display as dpy.
+    Display* const dpy = display_;
+    xXTestFakeInputReq* req;
+    LockDisplay(dpy);
+    GetReq(XTestFakeInput, req);
+    req->reqType = xtest_opcode_;
+    req->xtReqType = X_XTestFakeInput;
+    req->type = type;
+    req->detail = detail;
+    req->time = CurrentTime;
+    req->root = type == MotionNotify ? root_ : None;
+    req->rootX = x;
+    req->rootY = y;
+    req->deviceid = 0;
+    UnlockDisplay(dpy);
+    SyncHandle();
+  }
+
+  Display* const display_;
+  const Window root_;
+  const int ipc_fd_;
+  const Counters* const counters_;
+  const Atom client_list_;
+  bool has_xtest_;
+  int xtest_opcode_;
+};
+
+int ConnectIpc(const char* path) {
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+  // The window manager may still be starting up.
+  for (int attempt = 0; attempt < 100; ++attempt) {
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) ==
+        0) {
+      return fd;
+    }
+    close(fd);
+    usleep(50000);
+  }
+  perror(path);
+  exit(EXIT_FAILURE);
+}
+
+void Report(const char* name, Samples* samples) {
+  vector<double>& l = samples->latencies_us;
+  if (l.empty()) {
+    printf("%-8s %8s %10s %10s %10s %10s\n", name, "-", "-", "-", "-", "-");
+    return;
+  }
+  ::std::sort(l.begin(), l.end());
+  const size_t n = l.size();
+  printf(
+      "%-8s %8zu %10.0f %10.0f %10.1f %10.1f%s\n",
+      name, n, l[n / 2], l[::std::min(n - 1, n * 99 / 100)],
+      static_cast<double>(samples->requests) / n,
+      static_cast<double>(samples->replies) / n,
+      samples->timeouts ? " (with timeouts)" : "");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    fprintf(stderr, "Usage: %s <IPC socket> <counters file> [clients] "
+            "[iterations]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  const int client_count = argc > 3 ? atoi(argv[3]) : 20;
+  const int iterations = argc > 4 ? atoi(argv[4]) : 50;
+  // 1. Connect to everything.
+  Display* display = XOpenDisplay(nullptr);
+  if (display == nullptr) {
+    fprintf(stderr, "Failed to open display\n");
+    return EXIT_FAILURE;
+  }
+  const int counters_fd = open(argv[2], O_RDONLY);
+  if (counters_fd < 0) {
+    perror(argv[2]);
+    return EXIT_FAILURE;
+  }
+  const Counters* counters = static_cast<const Counters*>(mmap(
+      nullptr, sizeof(Counters), PROT_READ, MAP_SHARED, counters_fd, 0));
+  Bench bench(display, ConnectIpc(argv[1]), counters);
+  // 2. Map the dummy clients, and tile them.
+  ::std::map<string, Samples> samples;
+  vector<Window> clients;
+  for (int i = 0; i < client_count; ++i) {
+    clients.push_back(bench.MapClient(&samples["map"]));
+  }
+  bench.Command(&samples["tile"], ConfigureNotify, "tile");
+  // 3. Run the script.
+  char window[32];
+  for (int i = 0; i < iterations; ++i) {
+    const Window victim = bench.MapClient(&samples["map"]);
+    bench.Command(&samples["tile"], ConfigureNotify, "tile");
+    snprintf(window, sizeof(window), "0x%lx", clients[i % clients.size()]);
+    bench.Command(
+        &samples["swap"], ConfigureNotify, string("swap ") + window + " right");
+    bench.Command(
+        &samples["resize"], ConfigureNotify,
+        string("resize-by ") + window + (i % 2 ? " -20" : " 20"));
+    bench.Drag(&samples["drag"], clients[(i + 1) % clients.size()], 10);
+    snprintf(window, sizeof(window), "0x%lx", victim);
+    bench.Command(&samples["kill"], PropertyNotify, string("close ") + window);
+  }
+  // 4. Report.
+  printf("%d clients, %d iterations\n", client_count, iterations);
+  printf("%-8s %8s %10s %10s %10s %10s\n",
+         "op", "samples", "p50 us", "p99 us", "requests", "replies");
+  for (const char* op : {"map", "tile", "swap", "resize", "drag", "kill"}) {
+    Report(op, &samples[op]);
+  }
+  if (!bench.has_xtest()) {
+    printf("XTEST is unavailable, drags were skipped\n");
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,102 @@
+// Micro-benchmarks of the layout engine, which runs without an X server.
+//
+// Usage: make layout_bench && ./layout_bench
+#include <benchmark/benchmark.h>
+#include "../layout.hpp"
+
+namespace {
+
+const Rect AREA(0, 24, 2560, 1416);
+
+// Returns a layout of n tiles, for windows 1 to n.
+Layout MakeLayout(int n) {
+  Layout layout;
+  for (int i = 1; i <= n; ++i) {
+    layout.Insert(i);
+  }
+  return layout;
+}
+
+// A relayout pass: the target rectangle of every tile.
+void BM_Arrange(benchmark::State& state) {
+  const Layout layout = MakeLayout(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(layout.Arrange(AREA));
+  }
+  state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_Arrange)->RangeMultiplier(10)->Range(1, 1000)->Complexity();
+
+// A full relayout pass in each layout mode, for 1 to 1000 tiles.
+void BM_ArrangeMode(benchmark::State& state) {
+  Layout layout = MakeLayout(state.range(1));
+  layout.set_mode(static_cast<LayoutMode>(state.range(0)));
+  state.SetLabel(LayoutModeName(layout.mode()));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(layout.Arrange(AREA));
+  }
+}
+BENCHMARK(BM_ArrangeMode)
+    ->ArgsProduct({{0, 1, 2, 3}, benchmark::CreateRange(1, 1000, 10)});
+
+// Mapping and unmapping a window in each layout mode, with incremental
+// relayouts that only return the tiles that moved.
+void BM_InsertRemoveRearrange(benchmark::State& state) {
+  Layout layout = MakeLayout(state.range(1));
+  layout.set_mode(static_cast<LayoutMode>(state.range(0)));
+  state.SetLabel(LayoutModeName(layout.mode()));
+  layout.Rearrange(AREA);
+  const Window w = state.range(1) + 1;
+  size_t changed = 0;
+  for (auto _ : state) {
+    layout.Insert(w);
+    changed += layout.Rearrange(AREA).size();
+    layout.Remove(w);
+    changed += layout.Rearrange(AREA).size();
+  }
+  // Windows a relayout has to reconfigure, per map or unmap.
+  state.counters["changed"] = benchmark::Counter(
+      changed / 2.0, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_InsertRemoveRearrange)
+    ->ArgsProduct({{0, 1, 2, 3}, benchmark::CreateRange(1, 1000, 10)});
+
+// Mapping and unmapping a window.
+void BM_InsertRemove(benchmark::State& state) {
+  Layout layout = MakeLayout(state.range(0));
+  const Window w = state.range(0) + 1;
+  for (auto _ : state) {
+    layout.Insert(w);
+    layout.Remove(w);
+  }
+}
+BENCHMARK(BM_InsertRemove)->RangeMultiplier(10)->Range(1, 1000);
+
+// Alt+d followed by a relayout pass.
+void BM_SwapAndArrange(benchmark::State& state) {
+  Layout layout = MakeLayout(state.range(0) + 1);
+  const Window w = state.range(0) / 2 + 1;
+  for (auto _ : state) {
+    layout.Swap(w, layout.Next(w));
+    benchmark::DoNotOptimize(layout.Arrange(AREA));
+  }
+}
+BENCHMARK(BM_SwapAndArrange)->RangeMultiplier(10)->Range(1, 1000);
+
+// Alt+Right followed by a relayout pass. Growing and shrinking in turns keeps
+// the layout from running out of room.
+void BM_ResizeAndArrange(benchmark::State& state) {
+  Layout layout = MakeLayout(state.range(0) + 1);
+  const Window w = state.range(0) / 2 + 1;
+  int pixels = 1;
+  for (auto _ : state) {
+    layout.Resize(w, pixels, AREA);
+    pixels = -pixels;
+    benchmark::DoNotOptimize(layout.Arrange(AREA));
+  }
+}
+BENCHMARK(BM_ResizeAndArrange)->RangeMultiplier(10)->Range(1, 1000);
+
+}  // namespace
+
+BENCHMARK_MAIN();
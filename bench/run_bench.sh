@@ -0,0 +1,55 @@
+#!/bin/sh
+# Runs e2e_bench against basic_wm on a virtual X server.
+#
+# basic_wm connects through x_proxy, which counts its X protocol traffic, and
+# runs with the default configuration. Arguments are passed on to e2e_bench.
+# BENCH_XSERVER selects the X server, Xvfb by default, and BENCH_DISPLAY its
+# display number.
+set -e
+cd "$(dirname "$0")/.."
+
+XSERVER=${BENCH_XSERVER:-Xvfb}
+DISPLAY_NUMBER=${BENCH_DISPLAY:-201}
+PROXY_NUMBER=$((DISPLAY_NUMBER + 1))
+WORK_DIR=$(mktemp -d)
+PIDS=
+
+cleanup() {
+  for pid in $PIDS; do
+    kill "$pid" 2>/dev/null || true
+  done
+  wait 2>/dev/null || true
+  rm -rf "$WORK_DIR"
+}
+trap cleanup EXIT INT TERM
+
+wait_for_socket() {
+  for _ in $(seq 100); do
+    [ -S "$1" ] && return 0
+    sleep 0.05
+  done
+  echo "Timed out waiting for $1" >&2
+  exit 1
+}
+
+# 1. Start the X server, and the proxy in front of it.
+case "$XSERVER" in
+  Xephyr) "$XSERVER" ":$DISPLAY_NUMBER" -screen 1920x1080 -ac & ;;
+  *) "$XSERVER" ":$DISPLAY_NUMBER" -screen 0 1920x1080x24 -ac & ;;
+esac
+PIDS="$PIDS $!"
+wait_for_socket "/tmp/.X11-unix/X$DISPLAY_NUMBER"
+./x_proxy "$DISPLAY_NUMBER" "$PROXY_NUMBER" "$WORK_DIR/counters" &
+PIDS="$PIDS $!"
+wait_for_socket "/tmp/.X11-unix/X$PROXY_NUMBER"
+
+# 2. Start the window manager through the proxy.
+mkdir "$WORK_DIR/config"
+DISPLAY=":$PROXY_NUMBER" XDG_CONFIG_HOME="$WORK_DIR/config" \
+    BASIC_WM_SOCKET="$WORK_DIR/basic_wm.sock" \
+    ./basic_wm 2>"$WORK_DIR/basic_wm.log" &
+PIDS="$PIDS $!"
+
+# 3. Drive it directly.
+DISPLAY=":$DISPLAY_NUMBER" ./e2e_bench \
+    "$WORK_DIR/basic_wm.sock" "$WORK_DIR/counters" "$@"
@@ -0,0 +1,278 @@
+// A pass-through X11 proxy that counts the protocol traffic of its clients.
+//
+// Usage: x_proxy <upstream display> <proxy display> <counters file>
+//
+// Listens as display :<proxy display>, forwards every connection to display
+// :<upstream display>, and keeps running totals of requests, replies, events
+// and errors in <counters file>, which other processes can map as Counters.
+// This stands in for the RECORD extension, for which no client library is
+// available here.
+extern "C" {
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+}
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+#include "x_proxy.hpp"
+
+using ::std::string;
+using ::std::vector;
+
+namespace {
+
+// Parses one direction of an X connection, counting messages.
+class StreamParser {
+ public:
+  // big_endian is the byte order of the connection, shared by both of its
+  // directions, and set from the client's setup request.
+  StreamParser(bool from_client, bool* big_endian, Counters* counters)
+      : from_client_(from_client),
+        big_endian_(big_endian),
+        counters_(counters) {
+  }
+
+  // Consumes data, which was forwarded as it is.
+  void Feed(const char* data, size_t length) {
+    buffer_.append(data, length);
+    size_t used;
+    while ((used = Parse()) > 0) {
+      buffer_.erase(0, used);
+    }
+  }
+
+ private:
+  uint32_t Card16(size_t offset) const {
+    const unsigned char* p =
+        reinterpret_cast<const unsigned char*>(buffer_.data()) + offset;
+    return *big_endian_ ? (p[0] << 8 | p[1]) : (p[1] << 8 | p[0]);
+  }
+  uint32_t Card32(size_t offset) const {
+    const uint32_t high = Card16(offset + (*big_endian_ ? 0 : 2));
+    const uint32_t low = Card16(offset + (*big_endian_ ? 2 : 0));
+    return high << 16 | low;
+  }
+
+  // Returns the size of the message at the start of the buffer if it is
+  // complete, after counting it, or 0 otherwise.
+  size_t Parse() {
+    if (from_client_) {
+      return ParseFromClient();
+    }
+    return ParseFromServer();
+  }
+
+  size_t ParseFromClient() {
+    if (!setup_done_) {
+      // Connection setup: byte order, version, then padded authorization.
+      if (buffer_.size() < 12) {
+        return 0;
+      }
+      *big_endian_ = buffer_[0] == 'B';
+      const size_t length = 12 + Pad(Card16(6)) + Pad(Card16(8));
+      if (buffer_.size() < length) {
+        return 0;
+      }
+      setup_done_ = true;
+      return length;
+    }
+    if (buffer_.size() < 4) {
+      return 0;
+    }
+    // Requests give their length in 4 byte units, or 0 and a 32 bit length
+    // after the header with BIG-REQUESTS.
+    size_t length = Card16(2) * 4;
+    if (length == 0) {
+      if (buffer_.size() < 8) {
+        return 0;
+      }
+      length = Card32(4) * 4;
+    }
+    if (length < 4 || buffer_.size() < length) {
+      return 0;
+    }
+    ++counters_->requests;
+    return length;
+  }
+
+  size_t ParseFromServer() {
+    if (!setup_done_) {
+      // Setup reply: 8 byte header and additional data.
+      if (buffer_.size() < 8) {
+        return 0;
+      }
+      const size_t length = 8 + Card16(6) * 4;
+      if (buffer_.size() < length) {
+        return 0;
+      }
+      setup_done_ = true;
+      return length;
+    }
+    if (buffer_.size() < 32) {
+      return 0;
+    }
+    // Replies and generic events carry additional data.
+    const int type = buffer_[0] & 0x7f;
+    size_t length = 32;
+    if (type == 1 || type == GENERIC_EVENT) {
+      length += Card32(4) * 4;
+    }
+    if (buffer_.size() < length) {
+      return 0;
+    }
+    if (type == 0) {
+      ++counters_->errors;
+    } else if (type == 1) {
+      ++counters_->replies;
+    } else {
+      ++counters_->events;
+    }
+    return length;
+  }
+
+  static size_t Pad(size_t n) {
+    return (n + 3) & ~3;
+  }
+
+  static const int GENERIC_EVENT = 35;
+
+  const bool from_client_;
+  bool* const big_endian_;
+  Counters* const counters_;
+  string buffer_;
+  bool setup_done_ = false;
+};
+
+// A proxied connection.
+struct Connection {
+  int client_fd;
+  int server_fd;
+  bool big_endian;
+  StreamParser from_client;
+  StreamParser from_server;
+
+  Connection(int client, int server, Counters* counters)
+      : client_fd(client),
+        server_fd(server),
+        big_endian(false),
+        from_client(true, &big_endian, counters),
+        from_server(false, &big_endian, counters) {
+  }
+};
+
+string SocketPath(const char* display) {
+  return string("/tmp/.X11-unix/X") + display;
+}
+
+int ConnectUpstream(const string& path) {
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address))) {
+    perror("connect");
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// Forwards what is readable on from to to. Returns false once from is closed.
+bool Forward(int from, int to, StreamParser* parser) {
+  char buffer[65536];
+  const ssize_t length = read(from, buffer, sizeof(buffer));
+  if (length <= 0) {
+    return false;
+  }
+  for (ssize_t written = 0; written < length;) {
+    const ssize_t n = write(to, buffer + written, length - written);
+    if (n <= 0) {
+      return false;
+    }
+    written += n;
+  }
+  parser->Feed(buffer, length);
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc != 4) {
+    fprintf(stderr, "Usage: %s <upstream display> <proxy display> "
+            "<counters file>\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  // 1. Map counters.
+  const int counters_fd = open(argv[3], O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (counters_fd < 0 || ftruncate(counters_fd, sizeof(Counters)) != 0) {
+    perror(argv[3]);
+    return EXIT_FAILURE;
+  }
+  Counters* counters = static_cast<Counters*>(mmap(
+      nullptr, sizeof(Counters), PROT_READ | PROT_WRITE, MAP_SHARED,
+      counters_fd, 0));
+  new (counters) Counters();
+  // 2. Listen as the proxy display.
+  const string upstream = SocketPath(argv[1]);
+  const string path = SocketPath(argv[2]);
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  unlink(path.c_str());
+  const int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) ||
+      listen(listen_fd, 16)) {
+    perror(path.c_str());
+    return EXIT_FAILURE;
+  }
+  // 3. Forward until killed.
+  vector<Connection*> connections;
+  for (;;) {
+    vector<pollfd> fds = {{listen_fd, POLLIN, 0}};
+    for (const Connection* c : connections) {
+      fds.push_back({c->client_fd, POLLIN, 0});
+      fds.push_back({c->server_fd, POLLIN, 0});
+    }
+    if (poll(fds.data(), fds.size(), -1) < 0) {
+      continue;
+    }
+    if (fds[0].revents & POLLIN) {
+      const int client_fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+      const int server_fd = client_fd < 0 ? -1 : ConnectUpstream(upstream);
+      if (server_fd >= 0) {
+        connections.push_back(new Connection(client_fd, server_fd, counters));
+      } else if (client_fd >= 0) {
+        close(client_fd);
+      }
+    }
+    vector<Connection*> remaining;
+    for (size_t i = 0; i < connections.size(); ++i) {
+      Connection* c = connections[i];
+      const pollfd& client = fds[1 + 2 * i];
+      const pollfd& server = fds[2 + 2 * i];
+      bool alive = true;
+      if (client.revents) {
+        alive = Forward(c->client_fd, c->server_fd, &c->from_client);
+      }
+      if (alive && server.revents) {
+        alive = Forward(c->server_fd, c->client_fd, &c->from_server);
+      }
+      if (alive) {
+        remaining.push_back(c);
+      } else {
+        close(c->client_fd);
+        close(c->server_fd);
+        delete c;
+      }
+    }
+    connections.swap(remaining);
+  }
+}
@@ -0,0 +1,19 @@
+#ifndef BENCH_X_PROXY_HPP
+#define BENCH_X_PROXY_HPP
+
+#include <atomic>
+#include <cstdint>
+
+// Running totals of the X protocol traffic through x_proxy, shared through a
+// memory mapped file.
+struct Counters {
+  // Requests sent by clients.
+  ::std::atomic<uint64_t> requests{0};
+  // Replies, events and errors sent by the server. Every reply is a request
+  // some client waited for, so replies count round trips at most.
+  ::std::atomic<uint64_t> replies{0};
+  ::std::atomic<uint64_t> events{0};
+  ::std::atomic<uint64_t> errors{0};
+};
+
+#endif
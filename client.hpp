@@ -0,0 +1,74 @@
+#ifndef CLIENT_HPP
+#define CLIENT_HPP
+
+extern "C" {
+#include <X11/Xlib.h>
+}
+#include <cstddef>
+#include <cstdint>
+#include "util.hpp"
+
+// How a top-level window takes part in window management.
+enum class WindowType {
+  // A regular application window. Framed and tiled.
+  NORMAL,
+  // A status bar or desktop window (_NET_WM_WINDOW_TYPE_DOCK/_DESKTOP). Left
+  // unframed and excluded from tiling.
+  DOCK,
+};
+
+// Everything we know about a top-level window we manage. The geometry fields
+// mirror the server-side state and are kept up to date from ConfigureNotify,
+// MapNotify and UnmapNotify, so that layout and neighbor lookups can be
+// answered from memory instead of with round trips.
+struct Client {
+  // The client window itself.
+  Window window;
+  // The frame we reparented the client into, or None for docks.
+  Window frame;
+  // Position and size of the frame relative to the root window. For docks,
+  // which have no frame, this is the geometry of the window itself.
+  Position<int> frame_pos;
+  Size<int> frame_size;
+  // Position and size of the client window relative to its frame.
+  Position<int> client_pos;
+  Size<int> client_size;
+  // Whether the client window is currently mapped.
+  bool mapped;
+  // Whether the frame has been mapped. Frames of windows that map themselves
+  // are left unmapped until their first relayout puts them in place.
+  bool placed;
+  WindowType type;
+  // Whether the client lists WM_DELETE_WINDOW in its WM_PROTOCOLS property,
+  // and so can be asked to close rather than be killed.
+  bool deletable;
+  // Index of the monitor and workspace whose layout the client is tiled in.
+  size_t monitor;
+  size_t workspace;
+  // Neighbors in the focus history, maintained by FocusList. Docks are never
+  // in it.
+  Client* focus_newer;
+  Client* focus_older;
+  // Handle of the record in its ClientTable.
+  uint32_t slot;
+
+  Client()
+      : window(None),
+        frame(None),
+        frame_pos(0, 0),
+        frame_size(0, 0),
+        client_pos(0, 0),
+        client_size(0, 0),
+        mapped(false),
+        placed(false),
+        type(WindowType::NORMAL),
+        deletable(false),
+        monitor(0),
+        workspace(0),
+        focus_newer(nullptr),
+        focus_older(nullptr),
+        slot(0) {
+  }
+};
+
+#endif
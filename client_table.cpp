@@ -0,0 +1,128 @@
+#include "client_table.hpp"
+#include <glog/logging.h>
+
+// Smallest number of hash table entries.
+static const size_t MIN_INDEX_CAPACITY = 64;
+
+// Returns the ideal position of xid in a hash table of the given capacity, a
+// power of two. Window IDs of one client are mostly sequential, which
+// Fibonacci hashing spreads over the whole table.
+static size_t HashWindow(Window xid, size_t capacity) {
+  return (static_cast<uint64_t>(xid) * 0x9e3779b97f4a7c15ull) >>
+         (64 - __builtin_ctzll(capacity));
+}
+
+ClientTable::ClientTable()
+    : size_(0),
+      index_(MIN_INDEX_CAPACITY, IndexEntry{None, 0, false}),
+      index_size_(0) {
+}
+
+Client* ClientTable::Insert(Window w) {
+  CHECK(w != None);
+  CHECK(Find(w) == nullptr);
+  // 1. Take a free slot, or a new one.
+  Handle h;
+  if (!free_.empty()) {
+    h = free_.back();
+    free_.pop_back();
+  } else {
+    h = slots_.size();
+    slots_.emplace_back();
+  }
+  // 2. Start the record afresh, and index it.
+  Client& c = slots_[h];
+  c = Client();
+  c.window = w;
+  c.slot = h;
+  ++size_;
+  AddToIndex(w, h, false);
+  return &c;
+}
+
+void ClientTable::IndexFrame(Client* c) {
+  CHECK(c->frame != None);
+  AddToIndex(c->frame, c->slot, true);
+}
+
+void ClientTable::Erase(Client* c) {
+  RemoveFromIndex(c->window);
+  if (c->frame != None && FindByFrame(c->frame) == c) {
+    RemoveFromIndex(c->frame);
+  }
+  c->window = None;
+  c->frame = None;
+  free_.push_back(c->slot);
+  --size_;
+}
+
+Client* ClientTable::Find(Window w) {
+  return Lookup(w, false);
+}
+
+Client* ClientTable::FindByFrame(Window frame) {
+  return Lookup(frame, true);
+}
+
+Client* ClientTable::Lookup(Window xid, bool frame) {
+  if (xid == None) {
+    return nullptr;
+  }
+  const IndexEntry& entry = index_[Probe(xid)];
+  return entry.xid == xid && entry.frame == frame ?
+      &slots_[entry.handle] : nullptr;
+}
+
+size_t ClientTable::Probe(Window xid) const {
+  const size_t mask = index_.size() - 1;
+  size_t i = HashWindow(xid, index_.size());
+  while (index_[i].xid != None && index_[i].xid != xid) {
+    i = (i + 1) & mask;
+  }
+  return i;
+}
+
+void ClientTable::AddToIndex(Window xid, Handle handle, bool frame) {
+  if ((index_size_ + 1) * 2 > index_.size()) {
+    Rehash(index_.size() * 2);
+  }
+  IndexEntry& entry = index_[Probe(xid)];
+  CHECK(entry.xid == None) << "Window " << xid << " is indexed already";
+  entry = IndexEntry{xid, handle, frame};
+  ++index_size_;
+}
+
+void ClientTable::RemoveFromIndex(Window xid) {
+  // Entries after the removed one that can't be reached from their ideal
+  // position across the hole are moved back into it, so that empty entries
+  // always end probe sequences, and no tombstones are needed.
+  const size_t mask = index_.size() - 1;
+  size_t hole = Probe(xid);
+  if (index_[hole].xid != xid) {
+    return;
+  }
+  for (size_t i = (hole + 1) & mask; index_[i].xid != None;
+       i = (i + 1) & mask) {
+    const size_t ideal = HashWindow(index_[i].xid, index_.size());
+    // Whether ideal lies cyclically in (hole, i], in which case entry i is
+    // still reachable without crossing the hole.
+    const bool reachable =
+        hole <= i ? hole < ideal && ideal <= i : hole < ideal || ideal <= i;
+    if (!reachable) {
+      index_[hole] = index_[i];
+      hole = i;
+    }
+  }
+  index_[hole].xid = None;
+  --index_size_;
+}
+
+void ClientTable::Rehash(size_t capacity) {
+  ::std::vector<IndexEntry> old(capacity, IndexEntry{None, 0, false});
+  old.swap(index_);
+  for (const IndexEntry& entry : old) {
+    if (entry.xid != None) {
+      index_[Probe(entry.xid)] = entry;
+    }
+  }
+}
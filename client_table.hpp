@@ -0,0 +1,106 @@
+#ifndef CLIENT_TABLE_HPP
+#define CLIENT_TABLE_HPP
+
+extern "C" {
+#include <X11/X.h>
+}
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "client.hpp"
+
+// The records of all managed clients, looked up by client or frame window.
+//
+// Records are kept in a slot array whose slots never move, so a record stays at
+// the same address, and under the same handle, until it is erased. Slots of
+// erased records are reused by later ones. Client and frame windows share one
+// open addressing hash table with linear probing, so looking up a record from
+// either side of the reparent is a single probe into a flat array in the
+// common case, and unknown windows are never inserted by looking them up.
+class ClientTable {
+ public:
+  // Index of a record's slot.
+  typedef uint32_t Handle;
+
+  ClientTable();
+
+  // Adds a record for client window w, which must not have one yet, and
+  // returns it.
+  Client* Insert(Window w);
+  // Makes c findable by its frame window, which must be set.
+  void IndexFrame(Client* c);
+  // Removes c along with its index entries. c must not be used afterwards.
+  void Erase(Client* c);
+
+  // Returns the record of client window w, or nullptr if there is none.
+  Client* Find(Window w);
+  // Returns the record of the client framed by frame, or nullptr if frame
+  // isn't one of our frames.
+  Client* FindByFrame(Window frame);
+
+  // Returns the record with handle h, which must exist.
+  Client* Get(Handle h) { return &slots_[h]; }
+  Handle HandleOf(const Client* c) const { return c->slot; }
+
+  // Number of records.
+  size_t size() const { return size_; }
+
+  // Iterates over all records, in slot order.
+  class iterator {
+   public:
+    iterator(ClientTable* table, Handle h) : table_(table), h_(h) { Skip(); }
+    Client& operator*() const { return table_->slots_[h_]; }
+    Client* operator->() const { return &table_->slots_[h_]; }
+    iterator& operator++() {
+      ++h_;
+      Skip();
+      return *this;
+    }
+    bool operator!=(const iterator& other) const { return h_ != other.h_; }
+
+   private:
+    // Advances past free slots.
+    void Skip() {
+      while (h_ < table_->slots_.size() && table_->slots_[h_].window == None) {
+        ++h_;
+      }
+    }
+
+    ClientTable* table_;
+    Handle h_;
+  };
+  iterator begin() { return iterator(this, 0); }
+  iterator end() { return iterator(this, slots_.size()); }
+
+ private:
+  // An entry of the hash table. Entries with xid None are empty.
+  struct IndexEntry {
+    Window xid;
+    Handle handle;
+    // Whether xid is the frame of the record rather than its client window.
+    bool frame;
+  };
+
+  // Returns the position in index_ where xid is, or the empty one where it
+  // would go.
+  size_t Probe(Window xid) const;
+  void AddToIndex(Window xid, Handle handle, bool frame);
+  void RemoveFromIndex(Window xid);
+  // Looks xid up, returning the record only if the entry is of the given kind.
+  Client* Lookup(Window xid, bool frame);
+  // Rebuilds index_ with the given number of entries, a power of two.
+  void Rehash(size_t capacity);
+
+  // Slots of records. Free slots have window None. A deque, as it never moves
+  // its elements when growing at the end.
+  ::std::deque<Client> slots_;
+  // Free slots, reused last freed first.
+  ::std::vector<Handle> free_;
+  size_t size_;
+  // The hash table, at most half full, so that probe sequences stay short.
+  ::std::vector<IndexEntry> index_;
+  size_t index_size_;
+};
+
+#endif
@@ -0,0 +1,200 @@
+#include "config.hpp"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <glog/logging.h>
+
+using ::std::shared_ptr;
+using ::std::string;
+
+Config::Config()
+    : border_width(3),
+      border_color(0xff0000),
+      gap(0),
+      resize_step(100),
+      launcher("rofi -show drun"),
+      outline_resize(false),
+      focus_follows_mouse(false),
+      relayout_delay(20),
+      kill_timeout(5000),
+      key_bindings(DefaultKeyBindings()) {
+}
+
+namespace {
+
+// Returns s without leading and trailing whitespace.
+string Trim(const string& s) {
+  const char* const WHITESPACE = " \t\r";
+  const size_t begin = s.find_first_not_of(WHITESPACE);
+  if (begin == string::npos) {
+    return string();
+  }
+  return s.substr(begin, s.find_last_not_of(WHITESPACE) - begin + 1);
+}
+
+bool ParseInt(const string& value, int min, int* result) {
+  char* end;
+  errno = 0;
+  const long n = strtol(value.c_str(), &end, 10);
+  if (value.empty() || *end != '\0' || errno != 0 || n < min || n > 10000) {
+    return false;
+  }
+  *result = n;
+  return true;
+}
+
+// Parses a color written as #RRGGBB or 0xRRGGBB.
+bool ParseColor(const string& value, unsigned long* result) {
+  string digits;
+  if (value.compare(0, 1, "#") == 0) {
+    digits = value.substr(1);
+  } else if (value.compare(0, 2, "0x") == 0) {
+    digits = value.substr(2);
+  }
+  if (digits.size() != 6 ||
+      digits.find_first_not_of("0123456789abcdefABCDEF") != string::npos) {
+    return false;
+  }
+  *result = strtoul(digits.c_str(), nullptr, 16);
+  return true;
+}
+
+bool ParseBool(const string& value, bool* result) {
+  if (value == "true" || value == "yes" || value == "1") {
+    *result = true;
+  } else if (value == "false" || value == "no" || value == "0") {
+    *result = false;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Parses "<key combination> <action> [argument]", and adds the binding to
+// config, replacing any binding of the same key combination.
+bool ParseBinding(const string& value, Config* config) {
+  // 1. Split off key combination and action.
+  const size_t key_end = value.find_first_of(" \t");
+  if (key_end == string::npos) {
+    return false;
+  }
+  KeyBinding binding;
+  if (!ParseKeyCombination(
+          value.substr(0, key_end), &binding.modifiers, &binding.keysym)) {
+    return false;
+  }
+  const string rest = Trim(value.substr(key_end));
+  const size_t action_end = rest.find_first_of(" \t");
+  binding.action = rest.substr(0, action_end);
+  if (action_end != string::npos) {
+    binding.argument = Trim(rest.substr(action_end));
+  }
+  if (binding.action.empty()) {
+    return false;
+  }
+  // 2. Replace or add binding.
+  for (KeyBinding& existing : config->key_bindings) {
+    if (existing.modifiers == binding.modifiers &&
+        existing.keysym == binding.keysym) {
+      existing = binding;
+      return true;
+    }
+  }
+  config->key_bindings.push_back(binding);
+  return true;
+}
+
+// Applies one "key = value" setting to config. Returns false if the key is
+// unknown or the value malformed.
+bool ParseSetting(const string& key, const string& value, Config* config) {
+  int n;
+  if (key == "border_width") {
+    if (!ParseInt(value, 0, &n)) {
+      return false;
+    }
+    config->border_width = n;
+    return true;
+  }
+  if (key == "border_color") {
+    return ParseColor(value, &config->border_color);
+  }
+  if (key == "background_color") {
+    // Frames used to have a background. Still accepted, so that existing
+    // configuration files load without warnings.
+    unsigned long color;
+    return ParseColor(value, &color);
+  }
+  if (key == "gap") {
+    return ParseInt(value, 0, &config->gap);
+  }
+  if (key == "resize_step") {
+    return ParseInt(value, 1, &config->resize_step);
+  }
+  if (key == "launcher") {
+    if (value.empty()) {
+      return false;
+    }
+    config->launcher = value;
+    return true;
+  }
+  if (key == "outline_resize") {
+    return ParseBool(value, &config->outline_resize);
+  }
+  if (key == "focus_follows_mouse") {
+    return ParseBool(value, &config->focus_follows_mouse);
+  }
+  if (key == "relayout_delay") {
+    return ParseInt(value, 0, &config->relayout_delay);
+  }
+  if (key == "kill_timeout") {
+    return ParseInt(value, 0, &config->kill_timeout);
+  }
+  if (key == "bind") {
+    return ParseBinding(value, config);
+  }
+  return false;
+}
+
+}  // namespace
+
+string DefaultConfigPath() {
+  const char* config_home = getenv("XDG_CONFIG_HOME");
+  if (config_home != nullptr && *config_home != '\0') {
+    return string(config_home) + "/basic_wm/config";
+  }
+  const char* home = getenv("HOME");
+  return string(home == nullptr ? "" : home) + "/.config/basic_wm/config";
+}
+
+shared_ptr<const Config> LoadConfig(const string& path) {
+  shared_ptr<Config> config = ::std::make_shared<Config>();
+  // 1. Open file. A missing file just means the defaults are used.
+  ::std::ifstream in(path);
+  if (!in) {
+    if (errno != ENOENT) {
+      LOG(WARNING) << "Failed to read " << path << ": " << strerror(errno);
+    }
+    return config;
+  }
+  // 2. Apply settings line by line.
+  string line;
+  for (int line_number = 1; ::std::getline(in, line); ++line_number) {
+    // Only whole lines are comments, as colors start with "#" too.
+    line = Trim(line);
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    const size_t equals = line.find('=');
+    if (equals == string::npos ||
+        !ParseSetting(
+            Trim(line.substr(0, equals)),
+            Trim(line.substr(equals + 1)),
+            config.get())) {
+      LOG(WARNING) << path << ":" << line_number << ": Ignoring \"" << line
+                   << "\"";
+    }
+  }
+  LOG(INFO) << "Loaded configuration from " << path;
+  return config;
+}
@@ -0,0 +1,62 @@
+#ifndef CONFIG_HPP
+#define CONFIG_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "key_bindings.hpp"
+
+// Settings read from the configuration file. A Config is never modified once
+// loaded; reloading the file produces a new one, which replaces the old one as
+// a whole, so readers always see a consistent set of values.
+struct Config {
+  // Frame border width in pixels, and border color as 0xRRGGBB. Frames have
+  // no background of their own, as clients cover them entirely.
+  unsigned int border_width;
+  unsigned long border_color;
+  // Space between tiled windows, and between them and the screen edges, in
+  // pixels.
+  int gap;
+  // Pixels a "resize" binding without an explicit amount grows or shrinks a
+  // tile by.
+  int resize_step;
+  // Command a "spawn" binding without an argument runs.
+  ::std::string launcher;
+  // Whether alt + right button drags only show an outline of the new size, and
+  // resize the client once, on release.
+  bool outline_resize;
+  // Whether windows are focused when the pointer enters them.
+  bool focus_follows_mouse;
+  // Milliseconds to wait for more windows to be mapped or unmapped before
+  // tiling, so that a burst of them is laid out once. 0 tiles at the end of
+  // each event batch.
+  int relayout_delay;
+  // Milliseconds a client asked to close with WM_DELETE_WINDOW gets before it
+  // is killed. 0 never kills such clients.
+  int kill_timeout;
+  // Key bindings: the defaults, with the configured ones added or overriding
+  // defaults for the same key combination.
+  ::std::vector<KeyBinding> key_bindings;
+
+  // Creates the default configuration.
+  Config();
+};
+
+// Returns the path of the configuration file:
+// $XDG_CONFIG_HOME/basic_wm/config, or ~/.config/basic_wm/config.
+::std::string DefaultConfigPath();
+
+// Reads the configuration file at path. Each line sets one key, or is a
+// comment:
+//
+//   # Comment
+//   border_width = 3
+//   border_color = #ff0000
+//   gap = 8
+//   bind = Mod1+Return spawn xterm
+//
+// Settings the file doesn't mention keep their defaults, as does everything if
+// the file doesn't exist. Malformed lines are logged and skipped.
+::std::shared_ptr<const Config> LoadConfig(const ::std::string& path);
+
+#endif
@@ -0,0 +1,145 @@
+#include "event_loop.hpp"
+extern "C" {
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+}
+#include <cerrno>
+#include <cstdint>
+#include <glog/logging.h>
+
+EventLoop::EventLoop()
+    : epoll_fd_(epoll_create1(EPOLL_CLOEXEC)),
+      signal_fd_(-1),
+      running_(false) {
+  PCHECK(epoll_fd_ >= 0) << "Failed to create epoll instance";
+  sigemptyset(&signal_mask_);
+}
+
+EventLoop::~EventLoop() {
+  for (const auto& timer : timers_) {
+    close(timer.first);
+  }
+  if (signal_fd_ >= 0) {
+    close(signal_fd_);
+  }
+  close(epoll_fd_);
+}
+
+void EventLoop::Watch(int fd, Callback callback) {
+  epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.fd = fd;
+  const int op = callbacks_.count(fd) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+  PCHECK(epoll_ctl(epoll_fd_, op, fd, &event) == 0)
+      << "Failed to watch file descriptor " << fd;
+  callbacks_[fd] = callback;
+}
+
+void EventLoop::Unwatch(int fd) {
+  if (!callbacks_.erase(fd)) {
+    return;
+  }
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+int EventLoop::AddTimer(int delay_ms, bool periodic, Callback callback) {
+  // 1. Create and arm timerfd. A zero it_value would disarm it, so round up.
+  const int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  PCHECK(fd >= 0) << "Failed to create timer";
+  const long delay_ns = delay_ms > 0 ? delay_ms * 1000000L : 1;
+  itimerspec spec = {};
+  spec.it_value.tv_sec = delay_ns / 1000000000L;
+  spec.it_value.tv_nsec = delay_ns % 1000000000L;
+  if (periodic) {
+    spec.it_interval = spec.it_value;
+  }
+  PCHECK(timerfd_settime(fd, 0, &spec, nullptr) == 0) << "Failed to arm timer";
+  // 2. Watch it. One-shot timers are cancelled before the callback runs, so
+  // that the callback may add a new timer, which can reuse the fd number.
+  timers_[fd] = periodic;
+  Watch(fd, [this, fd, periodic, callback] {
+    uint64_t expirations;
+    if (read(fd, &expirations, sizeof(expirations)) < 0) {
+      return;
+    }
+    if (!periodic) {
+      CancelTimer(fd);
+    }
+    callback();
+  });
+  return fd;
+}
+
+void EventLoop::CancelTimer(int id) {
+  if (!timers_.erase(id)) {
+    return;
+  }
+  Unwatch(id);
+  close(id);
+}
+
+void EventLoop::HandleSignal(int signo, Callback callback) {
+  // 1. Block signal, so that it is only ever delivered through signal_fd_.
+  sigaddset(&signal_mask_, signo);
+  PCHECK(sigprocmask(SIG_BLOCK, &signal_mask_, nullptr) == 0);
+  // 2. Create or update signalfd.
+  const int fd = signalfd(signal_fd_, &signal_mask_, SFD_NONBLOCK | SFD_CLOEXEC);
+  PCHECK(fd >= 0) << "Failed to create signalfd";
+  if (signal_fd_ < 0) {
+    signal_fd_ = fd;
+    Watch(signal_fd_, [this] { OnSignals(); });
+  }
+  signal_callbacks_[signo] = callback;
+}
+
+void EventLoop::SetPrepareCallback(Callback callback) {
+  prepare_callback_ = callback;
+}
+
+void EventLoop::Run() {
+  const int MAX_EVENTS = 32;
+  epoll_event events[MAX_EVENTS];
+  running_ = true;
+  while (running_) {
+    // 1. Let sources with buffered input drain it before we sleep.
+    if (prepare_callback_) {
+      prepare_callback_();
+      if (!running_) {
+        break;
+      }
+    }
+    // 2. Sleep until some source is ready.
+    const int n = epoll_wait(epoll_fd_, events, MAX_EVENTS, -1);
+    if (n < 0) {
+      PCHECK(errno == EINTR) << "epoll_wait failed";
+      continue;
+    }
+    // 3. Dispatch. A callback may remove other sources, so look each one up
+    // afresh, and copy the callback in case it removes itself.
+    for (int i = 0; i < n && running_; ++i) {
+      auto callback = callbacks_.find(events[i].data.fd);
+      if (callback == callbacks_.end()) {
+        continue;
+      }
+      const Callback c = callback->second;
+      c();
+    }
+  }
+}
+
+void EventLoop::Stop() {
+  running_ = false;
+}
+
+void EventLoop::OnSignals() {
+  signalfd_siginfo info;
+  while (read(signal_fd_, &info, sizeof(info)) == sizeof(info)) {
+    auto callback = signal_callbacks_.find(info.ssi_signo);
+    if (callback != signal_callbacks_.end()) {
+      const Callback c = callback->second;
+      c();
+    }
+  }
+}
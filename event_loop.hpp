@@ -0,0 +1,63 @@
+#ifndef EVENT_LOOP_HPP
+#define EVENT_LOOP_HPP
+
+#include <csignal>
+#include <functional>
+#include <unordered_map>
+
+// A single threaded event loop multiplexing file descriptors, timers and
+// signals over epoll. Callbacks run on the thread that called Run(), and may
+// freely add or remove event sources, including their own.
+class EventLoop {
+ public:
+  typedef ::std::function<void()> Callback;
+
+  EventLoop();
+  ~EventLoop();
+
+  // Invokes callback whenever fd becomes readable. fd remains owned by the
+  // caller, who must Unwatch() it before closing it.
+  void Watch(int fd, Callback callback);
+  // Stops watching fd. Does nothing if fd isn't watched.
+  void Unwatch(int fd);
+
+  // Invokes callback once after delay_ms milliseconds, or every delay_ms
+  // milliseconds if periodic is set. Returns an ID for CancelTimer().
+  int AddTimer(int delay_ms, bool periodic, Callback callback);
+  // Cancels a timer returned by AddTimer(). Does nothing if the timer has
+  // already fired or been cancelled, or if id is -1.
+  void CancelTimer(int id);
+
+  // Invokes callback whenever signal signo is delivered to the process. The
+  // signal is blocked and received through a signalfd, so the callback runs
+  // as part of the loop rather than in signal context.
+  void HandleSignal(int signo, Callback callback);
+
+  // Sets a callback to invoke each time before the loop goes to sleep, for
+  // sources that may have buffered input without their fd becoming readable.
+  void SetPrepareCallback(Callback callback);
+
+  // Dispatches events until Stop() is called.
+  void Run();
+  // Makes Run() return after the current callback.
+  void Stop();
+
+ private:
+  // Reads pending signals from signal_fd_ and dispatches them.
+  void OnSignals();
+
+  // epoll instance all sources are registered with.
+  const int epoll_fd_;
+  // Callbacks of watched file descriptors, including timers and signal_fd_.
+  ::std::unordered_map<int, Callback> callbacks_;
+  // Timers among the watched file descriptors, mapped to whether they repeat.
+  ::std::unordered_map<int, bool> timers_;
+  // signalfd for all handled signals, or -1 if none are handled yet.
+  int signal_fd_;
+  sigset_t signal_mask_;
+  ::std::unordered_map<int, Callback> signal_callbacks_;
+  Callback prepare_callback_;
+  bool running_;
+};
+
+#endif
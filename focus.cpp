@@ -0,0 +1,78 @@
+#include "focus.hpp"
+#include <glog/logging.h>
+
+FocusList::FocusList()
+    : focused_(nullptr),
+      front_(nullptr),
+      back_(nullptr),
+      cycling_(false) {
+}
+
+void FocusList::Add(Client* c) {
+  CHECK(c->focus_newer == nullptr && c->focus_older == nullptr && front_ != c);
+  c->focus_newer = back_;
+  if (back_ != nullptr) {
+    back_->focus_older = c;
+  } else {
+    front_ = c;
+  }
+  back_ = c;
+}
+
+void FocusList::Remove(Client* c) {
+  if (focused_ == c) {
+    focused_ = nullptr;
+  }
+  Unlink(c);
+}
+
+void FocusList::Focus(Client* c, bool cycling) {
+  if (!cycling) {
+    EndCycle();
+    if (c != nullptr) {
+      Promote(c);
+    }
+  }
+  cycling_ = cycling;
+  focused_ = c;
+}
+
+void FocusList::EndCycle() {
+  if (cycling_ && focused_ != nullptr) {
+    Promote(focused_);
+  }
+  cycling_ = false;
+}
+
+Client* FocusList::Next(const Client* c) const {
+  return c->focus_older != nullptr ? c->focus_older : front_;
+}
+
+void FocusList::Promote(Client* c) {
+  if (front_ == c) {
+    return;
+  }
+  Unlink(c);
+  c->focus_older = front_;
+  if (front_ != nullptr) {
+    front_->focus_newer = c;
+  } else {
+    back_ = c;
+  }
+  front_ = c;
+}
+
+void FocusList::Unlink(Client* c) {
+  if (c->focus_newer != nullptr) {
+    c->focus_newer->focus_older = c->focus_older;
+  } else if (front_ == c) {
+    front_ = c->focus_older;
+  }
+  if (c->focus_older != nullptr) {
+    c->focus_older->focus_newer = c->focus_newer;
+  } else if (back_ == c) {
+    back_ = c->focus_newer;
+  }
+  c->focus_newer = nullptr;
+  c->focus_older = nullptr;
+}
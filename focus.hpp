@@ -0,0 +1,53 @@
+#ifndef FOCUS_HPP
+#define FOCUS_HPP
+
+#include "client.hpp"
+
+// The focused client, and the history of focused clients, most recently
+// focused first. The history is an intrusive list, linked through
+// Client::focus_newer and Client::focus_older, so that adding, removing and
+// promoting a client is constant time and never allocates, and its order never
+// depends on how clients are stored.
+//
+// Focus may move without reordering the history while cycling through it, so
+// that cycling visits every client rather than alternating between the two
+// most recent ones. The client cycling ends on is promoted once it does.
+class FocusList {
+ public:
+  FocusList();
+
+  // The focused client, or nullptr.
+  Client* focused() const { return focused_; }
+  // The most recently focused client, or nullptr if there are none.
+  Client* front() const { return front_; }
+  bool cycling() const { return cycling_; }
+
+  // Adds c to the history as the least recently focused client.
+  void Add(Client* c);
+  // Removes c from the history. c is no longer focused afterwards.
+  void Remove(Client* c);
+
+  // Makes c, which may be nullptr, the focused client. When cycling, the
+  // history is left as it is; otherwise the cycle, if any, ends, and c becomes
+  // the most recently focused client.
+  void Focus(Client* c, bool cycling);
+  // Ends the current cycle, promoting the client it ended on.
+  void EndCycle();
+
+  // Returns the client focused less recently than c, wrapping around to the
+  // most recent one after the least recent one.
+  Client* Next(const Client* c) const;
+
+ private:
+  // Moves c to the front of the history.
+  void Promote(Client* c);
+  void Unlink(Client* c);
+
+  Client* focused_;
+  // Most and least recently focused clients.
+  Client* front_;
+  Client* back_;
+  bool cycling_;
+};
+
+#endif
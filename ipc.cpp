@@ -0,0 +1,152 @@
+#include "ipc.hpp"
+extern "C" {
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+}
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <glog/logging.h>
+#include "trace.hpp"
+
+using ::std::string;
+using ::std::vector;
+
+// Connections that send more than this without a newline are dropped.
+static const size_t MAX_COMMAND_LENGTH = 64 * 1024;
+
+IpcServer::IpcServer(EventLoop* event_loop, Handler handler)
+    : event_loop_(CHECK_NOTNULL(event_loop)),
+      handler_(handler),
+      listen_fd_(-1) {
+}
+
+IpcServer::~IpcServer() {
+  while (!connections_.empty()) {
+    CloseConnection(connections_.begin()->first);
+  }
+  if (listen_fd_ >= 0) {
+    event_loop_->Unwatch(listen_fd_);
+    close(listen_fd_);
+    unlink(path_.c_str());
+  }
+}
+
+bool IpcServer::Listen(const string& path) {
+  // 1. Create socket.
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    LOG(ERROR) << "Socket path too long: " << path;
+    return false;
+  }
+  strcpy(address.sun_path, path.c_str());
+  listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  PCHECK(listen_fd_ >= 0) << "Failed to create socket";
+  // 2. Bind it, replacing a socket left behind by a previous instance. Only
+  // the owner may connect.
+  unlink(path.c_str());
+  const mode_t umask_before = umask(0077);
+  const int result = bind(
+      listen_fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+  umask(umask_before);
+  if (result != 0 || listen(listen_fd_, 16) != 0) {
+    PLOG(ERROR) << "Failed to listen on " << path;
+    close(listen_fd_);
+    listen_fd_ = -1;
+    return false;
+  }
+  path_ = path;
+  // 3. Accept connections from the event loop.
+  event_loop_->Watch(listen_fd_, [this] { OnAccept(); });
+  LOG(INFO) << "Listening for commands on " << path;
+  return true;
+}
+
+string IpcServer::DefaultPath(const string& display_name) {
+  const char* path = getenv("BASIC_WM_SOCKET");
+  if (path != nullptr && *path != '\0') {
+    return path;
+  }
+  const char* runtime_dir = getenv("XDG_RUNTIME_DIR");
+  if (runtime_dir != nullptr && *runtime_dir != '\0') {
+    return string(runtime_dir) + "/basic_wm" + display_name + ".sock";
+  }
+  return "/tmp/basic_wm-" + ::std::to_string(getuid()) + display_name +
+      ".sock";
+}
+
+void IpcServer::OnAccept() {
+  int fd;
+  while ((fd = accept4(listen_fd_, nullptr, nullptr,
+                       SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+    connections_[fd];
+    event_loop_->Watch(fd, [this, fd] { OnReadable(fd); });
+    TRACE(DEBUG) << "Accepted IPC connection " << fd;
+  }
+}
+
+void IpcServer::OnReadable(int fd) {
+  // 1. Read everything available.
+  string& buffer = connections_[fd];
+  char chunk[4096];
+  ssize_t length;
+  bool closed = false;
+  while ((length = read(fd, chunk, sizeof(chunk))) != 0) {
+    if (length < 0) {
+      closed = errno != EAGAIN && errno != EINTR;
+      break;
+    }
+    buffer.append(chunk, length);
+  }
+  if (length == 0) {
+    closed = true;
+  }
+  // 2. Split off complete commands, and run them as one batch.
+  vector<string> commands;
+  size_t begin = 0, end;
+  while ((end = buffer.find('\n', begin)) != string::npos) {
+    commands.push_back(buffer.substr(begin, end - begin));
+    begin = end + 1;
+  }
+  buffer.erase(0, begin);
+  if (!commands.empty()) {
+    // 3. Send the replies. Replies are small, so a client that doesn't read
+    // them and fills up the socket buffer is dropped rather than buffered for.
+    const string replies = handler_(commands);
+    if (send(fd, replies.data(), replies.size(), MSG_NOSIGNAL) !=
+        static_cast<ssize_t>(replies.size())) {
+      closed = true;
+    }
+  }
+  if (closed || buffer.size() > MAX_COMMAND_LENGTH) {
+    CloseConnection(fd);
+  }
+}
+
+void IpcServer::CloseConnection(int fd) {
+  event_loop_->Unwatch(fd);
+  close(fd);
+  connections_.erase(fd);
+  TRACE(DEBUG) << "Closed IPC connection " << fd;
+}
+
+string JsonString(const string& s) {
+  string result = "\"";
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      result += '\\';
+      result += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char escape[8];
+      snprintf(escape, sizeof(escape), "\\u%04x", c);
+      result += escape;
+    } else {
+      result += c;
+    }
+  }
+  return result + "\"";
+}
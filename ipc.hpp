@@ -0,0 +1,53 @@
+#ifndef IPC_HPP
+#define IPC_HPP
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "event_loop.hpp"
+
+// A Unix domain socket accepting line-based commands, served by an event loop.
+// Clients send any number of newline-terminated commands per message, and get
+// one reply line per command back, in order. All complete commands of a
+// message are handed to the handler at once, so that the window manager can
+// apply them as one batch.
+class IpcServer {
+ public:
+  // Executes commands, and returns their replies, each terminated by a
+  // newline.
+  typedef ::std::function<::std::string(
+      const ::std::vector<::std::string>& commands)> Handler;
+
+  IpcServer(EventLoop* event_loop, Handler handler);
+  // Stops listening and removes the socket.
+  ~IpcServer();
+
+  // Starts listening at path, replacing any stale socket there. Returns false
+  // on failure.
+  bool Listen(const ::std::string& path);
+
+  // Returns the socket path for the given X display name: $BASIC_WM_SOCKET
+  // if set, or a display specific path in $XDG_RUNTIME_DIR or /tmp.
+  static ::std::string DefaultPath(const ::std::string& display_name);
+
+ private:
+  // Accepts a pending connection.
+  void OnAccept();
+  // Reads from a connection, and executes and replies to all complete commands.
+  void OnReadable(int fd);
+  void CloseConnection(int fd);
+
+  EventLoop* const event_loop_;
+  const Handler handler_;
+  // Listening socket, or -1.
+  int listen_fd_;
+  ::std::string path_;
+  // Partial commands received on each connection so far.
+  ::std::unordered_map<int, ::std::string> connections_;
+};
+
+// Returns s as a JSON string literal, quotes included.
+::std::string JsonString(const ::std::string& s);
+
+#endif
@@ -0,0 +1,95 @@
+#include "key_bindings.hpp"
+extern "C" {
+#include <X11/keysym.h>
+}
+#include <cstring>
+#include <sstream>
+
+using ::std::string;
+using ::std::vector;
+
+// Modifier names accepted by ParseKeyCombination().
+static const struct {
+  const char* name;
+  unsigned int mask;
+} MODIFIER_NAMES[] = {
+    {"Shift", ShiftMask},
+    {"Control", ControlMask},
+    {"Ctrl", ControlMask},
+    {"Mod1", Mod1Mask},
+    {"Alt", Mod1Mask},
+    {"Mod2", Mod2Mask},
+    {"Mod3", Mod3Mask},
+    {"Mod4", Mod4Mask},
+    {"Super", Mod4Mask},
+    {"Mod5", Mod5Mask},
+};
+
+bool ParseKeyCombination(
+    const string& text, unsigned int* modifiers, KeySym* keysym) {
+  // 1. Split into "+" separated parts. The last one names the key.
+  vector<string> parts;
+  ::std::istringstream in(text);
+  string part;
+  while (::std::getline(in, part, '+')) {
+    parts.push_back(part);
+  }
+  if (parts.empty() || parts.back().empty()) {
+    return false;
+  }
+  // 2. Resolve modifier names.
+  *modifiers = 0;
+  for (size_t i = 0; i + 1 < parts.size(); ++i) {
+    bool found = false;
+    for (const auto& modifier : MODIFIER_NAMES) {
+      if (strcasecmp(parts[i].c_str(), modifier.name) == 0) {
+        *modifiers |= modifier.mask;
+        found = true;
+        break;
+      }
+    }
+    if (!found) {
+      return false;
+    }
+  }
+  // 3. Resolve key name.
+  *keysym = XStringToKeysym(parts.back().c_str());
+  return *keysym != NoSymbol;
+}
+
+string FormatKeyCombination(unsigned int modifiers, KeySym keysym) {
+  string text;
+  for (const auto& modifier : MODIFIER_NAMES) {
+    // Skip aliases of modifiers already named.
+    if (modifiers & modifier.mask) {
+      text += modifier.name;
+      text += '+';
+      modifiers &= ~modifier.mask;
+    }
+  }
+  const char* name = XKeysymToString(keysym);
+  return text + (name != nullptr ? name : "NoSymbol");
+}
+
+vector<KeyBinding> DefaultKeyBindings() {
+  vector<KeyBinding> bindings = {
+      {Mod1Mask, XK_q, "close", ""},
+      {Mod1Mask, XK_Return, "spawn", ""},
+      {Mod1Mask, XK_Tab, "focus_next", ""},
+      {Mod1Mask, XK_t, "tile", ""},
+      {Mod1Mask, XK_Right, "resize", "+"},
+      {Mod1Mask, XK_Left, "resize", "-"},
+      {Mod1Mask, XK_d, "swap", "right"},
+      {Mod1Mask, XK_a, "swap", "left"},
+      {Mod1Mask, XK_space, "layout", "next"},
+      {Mod1Mask | ShiftMask, XK_r, "restart", ""},
+  };
+  // Alt + number shows a workspace, and Alt + Shift + number moves the window
+  // under the pointer there.
+  for (KeySym i = 1; i <= 9; ++i) {
+    const string n = ::std::to_string(i);
+    bindings.push_back({Mod1Mask, XK_0 + i, "workspace", n});
+    bindings.push_back({Mod1Mask | ShiftMask, XK_0 + i, "move_to_workspace", n});
+  }
+  return bindings;
+}
@@ -0,0 +1,33 @@
+#ifndef KEY_BINDINGS_HPP
+#define KEY_BINDINGS_HPP
+
+extern "C" {
+#include <X11/Xlib.h>
+}
+#include <string>
+#include <vector>
+
+// A key binding as the user writes it: a key combination, and the name of the
+// action it triggers along with an optional argument, e.g. Mod1+d running
+// "swap" with argument "right". Keysyms are resolved to keycodes by
+// the window manager, as that depends on the keyboard mapping.
+struct KeyBinding {
+  unsigned int modifiers;
+  KeySym keysym;
+  ::std::string action;
+  ::std::string argument;
+};
+
+// Parses a key combination such as "Mod1+Shift+Return" into a modifier mask
+// and a keysym. Returns false if the combination is malformed.
+bool ParseKeyCombination(
+    const ::std::string& text, unsigned int* modifiers, KeySym* keysym);
+
+// Formats a key combination the way ParseKeyCombination() accepts it, e.g.
+// "Mod1+Shift+Return".
+::std::string FormatKeyCombination(unsigned int modifiers, KeySym keysym);
+
+// Returns the key bindings used unless configured otherwise.
+::std::vector<KeyBinding> DefaultKeyBindings();
+
+#endif
@@ -0,0 +1,269 @@
+#include "layout.hpp"
+#include <cmath>
+#include <iterator>
+
+using ::std::next;
+using ::std::pair;
+using ::std::prev;
+using ::std::string;
+using ::std::vector;
+
+// Names of the layout modes, in LayoutMode order.
+static const char* const LAYOUT_MODE_NAMES[] = {
+    "columns",
+    "master",
+    "grid",
+    "monocle",
+};
+
+bool ParseLayoutMode(const string& name, LayoutMode* mode) {
+  for (size_t i = 0; i < sizeof(LAYOUT_MODE_NAMES) / sizeof(*LAYOUT_MODE_NAMES);
+       ++i) {
+    if (name == LAYOUT_MODE_NAMES[i]) {
+      *mode = static_cast<LayoutMode>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+const char* LayoutModeName(LayoutMode mode) {
+  return LAYOUT_MODE_NAMES[static_cast<size_t>(mode)];
+}
+
+void Layout::Insert(Window w) {
+  // New tiles get an average share, so that all tiles start out equal.
+  Insert(w, tiles_.empty() ? 1.0 : total_weight_ / tiles_.size());
+}
+
+void Layout::Insert(Window w, double weight) {
+  if (index_.count(w) || weight <= 0) {
+    return;
+  }
+  index_[w] = tiles_.insert(tiles_.end(), Tile{w, weight, Rect(), false});
+  total_weight_ += weight;
+}
+
+void Layout::Remove(Window w) {
+  auto i = index_.find(w);
+  if (i == index_.end()) {
+    return;
+  }
+  if (w == current_) {
+    // Show a neighbor instead.
+    const Window neighbor = Next(w);
+    current_ = neighbor != None ? neighbor : Prev(w);
+  }
+  total_weight_ -= i->second->weight;
+  tiles_.erase(i->second);
+  index_.erase(i);
+  if (tiles_.empty()) {
+    total_weight_ = 0;
+  }
+}
+
+bool Layout::Contains(Window w) const {
+  return index_.count(w) != 0;
+}
+
+Window Layout::Next(Window w) const {
+  auto i = index_.find(w);
+  if (i == index_.end()) {
+    return None;
+  }
+  auto n = next(i->second);
+  return n == tiles_.end() ? None : n->window;
+}
+
+Window Layout::Prev(Window w) const {
+  auto i = index_.find(w);
+  if (i == index_.end() || i->second == tiles_.begin()) {
+    return None;
+  }
+  return prev(i->second)->window;
+}
+
+void Layout::Swap(Window a, Window b) {
+  auto i = index_.find(a);
+  auto j = index_.find(b);
+  if (i == index_.end() || j == index_.end() || a == b) {
+    return;
+  }
+  // Windows trade places along with where they were last arranged, while the
+  // weights stay with the places.
+  ::std::swap(i->second->window, j->second->window);
+  ::std::swap(i->second->rect, j->second->rect);
+  ::std::swap(i->second->arranged, j->second->arranged);
+  ::std::swap(i->second, j->second);
+}
+
+Window Layout::current() const {
+  if (current_ != None && index_.count(current_)) {
+    return current_;
+  }
+  return tiles_.empty() ? None : tiles_.front().window;
+}
+
+void Layout::SetCurrent(Window w) {
+  if (index_.count(w)) {
+    current_ = w;
+  }
+}
+
+bool Layout::Resize(Window w, int pixels, const Rect& area) {
+  auto i = index_.find(w);
+  if (i == index_.end()) {
+    return false;
+  }
+  const TileIterator tile = i->second;
+  switch (mode_) {
+    case LayoutMode::COLUMNS:
+      return ResizeTiles(tile, pixels, total_weight_, area.width);
+    case LayoutMode::MASTER_STACK: {
+      if (tile != tiles_.begin()) {
+        return ResizeTiles(
+            tile, pixels, total_weight_ - tiles_.front().weight, area.height);
+      }
+      // Both master and stack keep at least a pixel.
+      const double fraction =
+          master_fraction_ + static_cast<double>(pixels) / area.width;
+      if (tiles_.size() < 2 || area.width <= 0 ||
+          fraction * area.width < 1 || (1 - fraction) * area.width < 1) {
+        return false;
+      }
+      master_fraction_ = fraction;
+      return true;
+    }
+    case LayoutMode::GRID:
+    case LayoutMode::MONOCLE:
+      break;
+  }
+  return false;
+}
+
+bool Layout::ResizeTiles(
+    TileIterator tile, int pixels, double weight, int extent) {
+  const TileIterator neighbor = next(tile);
+  if (neighbor == tiles_.end() || extent <= 0) {
+    return false;
+  }
+  const double delta = pixels * weight / extent;
+  if (tile->weight + delta <= 0 || neighbor->weight - delta <= 0) {
+    return false;
+  }
+  tile->weight += delta;
+  neighbor->weight -= delta;
+  return true;
+}
+
+vector<pair<Window, double>> Layout::Tiles() const {
+  vector<pair<Window, double>> tiles;
+  tiles.reserve(tiles_.size());
+  for (const Tile& tile : tiles_) {
+    tiles.emplace_back(tile.window, tile.weight);
+  }
+  return tiles;
+}
+
+template <typename F>
+void Layout::ForEachRect(const Rect& area, F f) const {
+  if (tiles_.empty()) {
+    return;
+  }
+  // Edges are rounded from the running weight (or count), so that tiles always
+  // line up exactly and the last one ends on the edge of the area.
+  switch (mode_) {
+    case LayoutMode::COLUMNS: {
+      double weight_before = 0;
+      int x = area.x;
+      for (const Tile& tile : tiles_) {
+        weight_before += tile.weight;
+        const int right = area.x + static_cast<int>(
+            ::std::lround(weight_before * area.width / total_weight_));
+        f(tile, Rect(x, area.y, right - x, area.height));
+        x = right;
+      }
+      break;
+    }
+    case LayoutMode::MASTER_STACK: {
+      const Tile& master = tiles_.front();
+      if (tiles_.size() == 1) {
+        f(master, area);
+        break;
+      }
+      const int stack_x = area.x + static_cast<int>(
+          ::std::lround(master_fraction_ * area.width));
+      f(master, Rect(area.x, area.y, stack_x - area.x, area.height));
+      const double stack_weight = total_weight_ - master.weight;
+      double weight_before = 0;
+      int y = area.y;
+      for (auto tile = next(tiles_.begin()); tile != tiles_.end(); ++tile) {
+        weight_before += tile->weight;
+        const int bottom = area.y + static_cast<int>(
+            ::std::lround(weight_before * area.height / stack_weight));
+        f(*tile,
+          Rect(stack_x, y, area.x + area.width - stack_x, bottom - y));
+        y = bottom;
+      }
+      break;
+    }
+    case LayoutMode::GRID: {
+      // The last row may have fewer cells, which are widened to fill it.
+      const int n = tiles_.size();
+      const int columns = static_cast<int>(::std::ceil(::std::sqrt(n)));
+      const int rows = (n + columns - 1) / columns;
+      int i = 0;
+      for (const Tile& tile : tiles_) {
+        const int row = i / columns, column = i % columns;
+        const int cells = row == rows - 1 ? n - columns * (rows - 1) : columns;
+        const int left = area.x + column * area.width / cells;
+        const int right = area.x + (column + 1) * area.width / cells;
+        const int top = area.y + row * area.height / rows;
+        const int bottom = area.y + (row + 1) * area.height / rows;
+        f(tile, Rect(left, top, right - left, bottom - top));
+        ++i;
+      }
+      break;
+    }
+    case LayoutMode::MONOCLE:
+      f(*index_.at(current()), area);
+      break;
+  }
+}
+
+vector<pair<Window, Rect>> Layout::Arrange(const Rect& area) const {
+  vector<pair<Window, Rect>> rects;
+  rects.reserve(tiles_.size());
+  ForEachRect(area, [&rects](const Tile& tile, const Rect& r) {
+    rects.emplace_back(tile.window, r);
+  });
+  return rects;
+}
+
+vector<pair<Window, Rect>> Layout::Rearrange(const Rect& area) {
+  vector<pair<Window, Rect>> rects;
+  ForEachRect(area, [&rects](const Tile& tile, const Rect& r) {
+    if (tile.arranged && tile.rect == r) {
+      return;
+    }
+    // ForEachRect() only hands out const tiles, but this layout isn't const.
+    Tile& t = const_cast<Tile&>(tile);
+    t.rect = r;
+    t.arranged = true;
+    rects.emplace_back(tile.window, r);
+  });
+  return rects;
+}
+
+void Layout::Invalidate(Window w) {
+  auto i = index_.find(w);
+  if (i != index_.end()) {
+    i->second->arranged = false;
+  }
+}
+
+void Layout::Invalidate() {
+  for (Tile& tile : tiles_) {
+    tile.arranged = false;
+  }
+}
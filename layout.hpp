@@ -0,0 +1,159 @@
+#ifndef LAYOUT_HPP
+#define LAYOUT_HPP
+
+extern "C" {
+#include <X11/X.h>
+}
+#include <cstddef>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Represents an axis-aligned rectangle.
+struct Rect {
+  int x, y, width, height;
+
+  Rect() = default;
+  Rect(int _x, int _y, int w, int h)
+      : x(_x), y(_y), width(w), height(h) {
+  }
+
+  bool operator == (const Rect& r) const {
+    return x == r.x && y == r.y && width == r.width && height == r.height;
+  }
+  bool operator != (const Rect& r) const {
+    return !(*this == r);
+  }
+
+  // Returns the rectangle shrunk by d on every side, but no smaller than 1x1.
+  Rect Inset(int d) const {
+    const int w = width - 2 * d, h = height - 2 * d;
+    return Rect(x + d, y + d, w > 0 ? w : 1, h > 0 ? h : 1);
+  }
+};
+
+// How a layout arranges its tiles.
+enum class LayoutMode {
+  // Side by side columns, sized by weight.
+  COLUMNS,
+  // The first tile on the left, and the others stacked on the right, sized by
+  // weight.
+  MASTER_STACK,
+  // Rows of equal cells, as square as possible.
+  GRID,
+  // The current tile fills the area, and the others stay where they are,
+  // hidden below it.
+  MONOCLE,
+};
+
+// Parses a layout mode name: "columns", "master", "grid" or "monocle". Returns
+// false if name isn't one.
+bool ParseLayoutMode(const ::std::string& name, LayoutMode* mode);
+// Returns the name of a layout mode, as accepted by ParseLayoutMode().
+const char* LayoutModeName(LayoutMode mode);
+
+// The tiling layout of a set of windows: an ordered list of tiles, each with a
+// weight that determines its share of the available space, arranged according
+// to a mode. The layout owns tile order and sizes, so neighbor lookup, swapping
+// and resizing are constant time and never depend on where windows happen to
+// be on screen.
+class Layout {
+ public:
+  Layout() = default;
+  // The index holds iterators into the tile list, which a copy would share
+  // with the original. Moving keeps them valid, as list nodes move along.
+  Layout(const Layout&) = delete;
+  Layout& operator=(const Layout&) = delete;
+  Layout(Layout&&) = default;
+  Layout& operator=(Layout&&) = default;
+
+  // Appends w as the rightmost tile.
+  void Insert(Window w);
+  // Appends w as the rightmost tile with the given weight, as returned by
+  // Tiles().
+  void Insert(Window w, double weight);
+  // Removes w's tile. Does nothing if w isn't tiled.
+  void Remove(Window w);
+  // Whether w has a tile in this layout.
+  bool Contains(Window w) const;
+  // Number of tiles.
+  size_t size() const { return tiles_.size(); }
+
+  // Returns the window tiled right after (or before) w, or None if w is the
+  // last (or first) tile or isn't tiled.
+  Window Next(Window w) const;
+  Window Prev(Window w) const;
+
+  // Exchanges the places of two tiled windows. Tile sizes stay where they are.
+  void Swap(Window a, Window b);
+
+  LayoutMode mode() const { return mode_; }
+  void set_mode(LayoutMode mode) { mode_ = mode; }
+
+  // The tile shown in monocle mode: the one last made current, or the first
+  // tile if that is gone. None if there are no tiles.
+  Window current() const;
+  // Makes w's tile the current one. Does nothing if w isn't tiled.
+  void SetCurrent(Window w);
+
+  // Grows w's tile by the given number of pixels (shrinks it if negative),
+  // taking the space from the tile after it: to its right in columns mode, and
+  // below it within the stack. In master/stack mode, resizing the master tile
+  // moves the edge between master and stack. area is what the layout is
+  // arranged in, used to turn pixels into weight. Returns false and leaves the
+  // layout unchanged if there is no such neighbor, either tile would end up
+  // with no space, or the mode doesn't size tiles.
+  bool Resize(Window w, int pixels, const Rect& area);
+
+  // Returns all tiled windows with their weights, in tile order.
+  ::std::vector<::std::pair<Window, double>> Tiles() const;
+
+  // Computes the rectangle of every tile, in tile order, when the layout is
+  // arranged within area. In monocle mode, that is only the current tile, as
+  // the others are left alone.
+  ::std::vector<::std::pair<Window, Rect>> Arrange(const Rect& area) const;
+  // Like Arrange(), but returns only the tiles whose rectangle differs from
+  // the one last returned for them, so that an incremental relayout touches
+  // nothing else. Tiles moved by other means than the layout must be
+  // invalidated to be returned again.
+  ::std::vector<::std::pair<Window, Rect>> Rearrange(const Rect& area);
+  // Forgets the rectangle last returned for w (or for all tiles), so that the
+  // next Rearrange() returns it.
+  void Invalidate(Window w);
+  void Invalidate();
+
+ private:
+  struct Tile {
+    Window window;
+    // Share of the total space, relative to the other tiles' weights.
+    double weight;
+    // Rectangle last returned by Rearrange(), if arranged is set.
+    Rect rect;
+    bool arranged;
+  };
+  typedef ::std::list<Tile>::iterator TileIterator;
+
+  // Tiles from left to right.
+  ::std::list<Tile> tiles_;
+  // Maps windows to their tiles.
+  ::std::unordered_map<Window, TileIterator> index_;
+  // Sum of all tile weights.
+  double total_weight_ = 0;
+  LayoutMode mode_ = LayoutMode::COLUMNS;
+  // See current().
+  Window current_ = None;
+  // Share of the width the master tile takes in master/stack mode.
+  double master_fraction_ = 0.5;
+
+  // Moves weight from tile to the tile after it, as Resize() does, where weight
+  // is the total weight spread over extent pixels.
+  bool ResizeTiles(TileIterator tile, int pixels, double weight, int extent);
+  // Calls f(tile, rect) with the rectangle of every tile arranged within
+  // area, in tile order. Tiles monocle mode leaves alone are skipped.
+  template <typename F>
+  void ForEachRect(const Rect& area, F f) const;
+};
+
+#endif
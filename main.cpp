@@ -1,3 +1,6 @@
+extern "C" {
+#include <unistd.h>
+}
 #include <cstdlib>
 #include <glog/logging.h>
 #include "window_manager.hpp"
@@ -14,6 +17,15 @@ int main(int argc, char** argv) {
   }
 
   window_manager->Run();
+  const bool restart = window_manager->restart_requested();
+  // Disconnect before starting over, so that the next instance can select
+  // substructure redirection on the root window.
+  window_manager.reset();
 
+  if (restart) {
+    execv("/proc/self/exe", argv);
+    PLOG(ERROR) << "Failed to restart window manager";
+    return EXIT_FAILURE;
+  }
   return EXIT_SUCCESS;
 }
@@ -0,0 +1,53 @@
+#include "process.hpp"
+extern "C" {
+#include <spawn.h>
+#include <sys/wait.h>
+}
+#include <csignal>
+#include <cstring>
+#include <glog/logging.h>
+#include "trace.hpp"
+
+extern char** environ;
+
+pid_t Spawn(const ::std::string& command) {
+  // 1. Undo what the event loop did to our signal handling, as the child would
+  // otherwise inherit blocked signals.
+  posix_spawnattr_t attr;
+  posix_spawnattr_init(&attr);
+  sigset_t signals;
+  sigemptyset(&signals);
+  posix_spawnattr_setsigmask(&attr, &signals);
+  sigfillset(&signals);
+  posix_spawnattr_setsigdefault(&attr, &signals);
+  // 2. Don't let signals meant for the window manager's process group, such as
+  // Ctrl+C in the terminal it was started from, reach what it launched.
+  posix_spawnattr_setflags(
+      &attr,
+      POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSID);
+  // 3. Spawn child.
+  const char* argv[] = {"/bin/sh", "-c", command.c_str(), nullptr};
+  pid_t pid;
+  const int error = posix_spawn(
+      &pid,
+      argv[0],
+      nullptr,
+      &attr,
+      const_cast<char* const*>(argv),
+      environ);
+  posix_spawnattr_destroy(&attr);
+  if (error != 0) {
+    LOG(ERROR) << "Failed to spawn \"" << command << "\": " << strerror(error);
+    return -1;
+  }
+  TRACE(INFO) << "Spawned \"" << command << "\" as " << pid;
+  return pid;
+}
+
+void ReapChildren() {
+  int status;
+  pid_t pid;
+  while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+    TRACE(INFO) << "Child " << pid << " exited with status " << status;
+  }
+}
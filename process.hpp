@@ -0,0 +1,18 @@
+#ifndef PROCESS_HPP
+#define PROCESS_HPP
+
+extern "C" {
+#include <sys/types.h>
+}
+#include <string>
+
+// Starts command with /bin/sh -c in a new session, without waiting for it to
+// finish. The child starts with all signals unblocked and set to their default
+// dispositions. Returns the child's pid, or -1 if it couldn't be started.
+pid_t Spawn(const ::std::string& command);
+
+// Collects the exit status of every child process that has terminated, without
+// blocking. Meant to be called on SIGCHLD.
+void ReapChildren();
+
+#endif
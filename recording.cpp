@@ -0,0 +1,297 @@
+#include "recording.hpp"
+extern "C" {
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+}
+#include <algorithm>
+#include <cstring>
+#include <glog/logging.h>
+
+using ::std::string;
+using ::std::unique_ptr;
+
+// Identifies recordings in EventRecord::header.
+static const char RECORDING_MAGIC[8] = "BWMREC1";
+
+unique_ptr<EventRecorder> EventRecorder::Create(
+    const string& path, Window root) {
+  const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                      0600);
+  if (fd < 0) {
+    PLOG(ERROR) << "Failed to create recording " << path;
+    return nullptr;
+  }
+  unique_ptr<EventRecorder> recorder(new EventRecorder(fd));
+  EventRecord* header = recorder->Append(EventRecord::HEADER);
+  memcpy(header->header.magic, RECORDING_MAGIC, sizeof(RECORDING_MAGIC));
+  header->header.root = root;
+  LOG(INFO) << "Recording events to " << path;
+  return recorder;
+}
+
+EventRecorder::EventRecorder(int fd)
+    : fd_(fd),
+      start_(::std::chrono::steady_clock::now()) {
+}
+
+EventRecorder::~EventRecorder() {
+  Flush();
+  close(fd_);
+}
+
+void EventRecorder::RecordAtom(Atom atom, const char* name) {
+  EventRecord* record = Append(EventRecord::ATOM);
+  record->atom.atom = atom;
+  strncpy(record->atom.name, name, sizeof(record->atom.name) - 1);
+}
+
+void EventRecorder::RecordEvent(const XEvent& e, bool coalesced) {
+  Append(coalesced ? EventRecord::COALESCED_EVENT : EventRecord::EVENT)
+      ->event = e;
+}
+
+void EventRecorder::RecordFrame(Window w, Window frame) {
+  EventRecord* record = Append(EventRecord::FRAME);
+  record->frame.window = w;
+  record->frame.frame = frame;
+}
+
+void EventRecorder::RecordDragTick() {
+  Append(EventRecord::DRAG_TICK);
+}
+
+void EventRecorder::RecordRelayoutTick() {
+  Append(EventRecord::RELAYOUT_TICK);
+}
+
+void EventRecorder::RecordBatchEnd() {
+  // Batches are finished before every sleep of the event loop, most of them
+  // empty, which aren't worth recording.
+  if (pending_.empty()) {
+    return;
+  }
+  Append(EventRecord::BATCH_END);
+  Flush();
+}
+
+EventRecord* EventRecorder::Append(EventRecord::Type type) {
+  pending_.emplace_back();
+  EventRecord* record = &pending_.back();
+  memset(record, 0, sizeof(*record));
+  record->type = type;
+  record->size = sizeof(EventRecord);
+  record->time_ns = ::std::chrono::duration_cast<::std::chrono::nanoseconds>(
+      ::std::chrono::steady_clock::now() - start_).count();
+  return record;
+}
+
+void EventRecorder::Flush() {
+  // A batch is written at once, so that a motion flood costs one write per
+  // batch rather than one per event.
+  const char* data = reinterpret_cast<const char*>(pending_.data());
+  size_t length = pending_.size() * sizeof(EventRecord);
+  while (length > 0) {
+    const ssize_t written = write(fd_, data, length);
+    if (written <= 0) {
+      PLOG(ERROR) << "Failed to write recording";
+      break;
+    }
+    data += written;
+    length -= written;
+  }
+  pending_.clear();
+}
+
+unique_ptr<Recording> Recording::Open(const string& path) {
+  // 1. Map the file.
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    PLOG(ERROR) << "Failed to open recording " << path;
+    return nullptr;
+  }
+  struct stat st;
+  CHECK_EQ(fstat(fd, &st), 0);
+  const size_t size = st.st_size / sizeof(EventRecord);
+  void* data = size == 0 ? MAP_FAILED :
+      mmap(nullptr, size * sizeof(EventRecord), PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    LOG(ERROR) << "Failed to map recording " << path;
+    return nullptr;
+  }
+  madvise(data, size * sizeof(EventRecord), MADV_SEQUENTIAL);
+  unique_ptr<Recording> recording(
+      new Recording(static_cast<const EventRecord*>(data), size));
+  // 2. Check that this build can read it.
+  const EventRecord& header = (*recording)[0];
+  if (header.type != EventRecord::HEADER ||
+      header.size != sizeof(EventRecord) ||
+      memcmp(header.header.magic, RECORDING_MAGIC, sizeof(RECORDING_MAGIC))) {
+    LOG(ERROR) << path << " isn't a recording of this build";
+    return nullptr;
+  }
+  return recording;
+}
+
+Recording::Recording(const EventRecord* records, size_t size)
+    : records_(records),
+      size_(size) {
+}
+
+Recording::~Recording() {
+  munmap(const_cast<EventRecord*>(records_), size_ * sizeof(EventRecord));
+}
+
+ReplayTranslator::ReplayTranslator(Display* display, Window recorded_root)
+    : display_(display) {
+  windows_[recorded_root] = DefaultRootWindow(display_);
+}
+
+ReplayTranslator::~ReplayTranslator() {
+  for (Window w : stand_ins_) {
+    XDestroyWindow(display_, w);
+  }
+}
+
+void ReplayTranslator::AddAtom(Atom recorded, const char* name) {
+  atoms_[recorded] = XInternAtom(display_, name, false);
+}
+
+void ReplayTranslator::AddWindow(Window recorded, Window live) {
+  windows_[recorded] = live;
+}
+
+Window ReplayTranslator::TranslateWindow(Window recorded, bool create) {
+  if (recorded == None) {
+    return None;
+  }
+  auto i = windows_.find(recorded);
+  if (i != windows_.end()) {
+    return i->second;
+  }
+  if (!create) {
+    return None;
+  }
+  // A window that existed before the recording started.
+  return CreateStandIn(
+      recorded, DefaultRootWindow(display_), 0, 0, 100, 100, false);
+}
+
+Atom ReplayTranslator::TranslateAtom(Atom recorded) const {
+  // Predefined atoms are the same on every display, and other atoms of the
+  // recording display we don't know about are unlikely to matter.
+  auto i = atoms_.find(recorded);
+  return i != atoms_.end() ? i->second : recorded;
+}
+
+void ReplayTranslator::Translate(XEvent* e) {
+  e->xany.display = display_;
+  switch (e->type) {
+    case KeyPress:
+    case KeyRelease:
+      e->xkey.window = TranslateWindow(e->xkey.window, true);
+      e->xkey.root = TranslateWindow(e->xkey.root, true);
+      e->xkey.subwindow = TranslateWindow(e->xkey.subwindow, true);
+      break;
+    case ButtonPress:
+    case ButtonRelease:
+      e->xbutton.window = TranslateWindow(e->xbutton.window, true);
+      e->xbutton.root = TranslateWindow(e->xbutton.root, true);
+      e->xbutton.subwindow = TranslateWindow(e->xbutton.subwindow, true);
+      break;
+    case MotionNotify:
+      e->xmotion.window = TranslateWindow(e->xmotion.window, true);
+      e->xmotion.root = TranslateWindow(e->xmotion.root, true);
+      e->xmotion.subwindow = TranslateWindow(e->xmotion.subwindow, true);
+      break;
+    case EnterNotify:
+    case LeaveNotify:
+      e->xcrossing.window = TranslateWindow(e->xcrossing.window, true);
+      e->xcrossing.root = TranslateWindow(e->xcrossing.root, true);
+      e->xcrossing.subwindow = TranslateWindow(e->xcrossing.subwindow, true);
+      break;
+    case CreateNotify: {
+      // A new window, even if its ID was used before.
+      XCreateWindowEvent& c = e->xcreatewindow;
+      c.parent = TranslateWindow(c.parent, true);
+      c.window = CreateStandIn(
+          c.window, c.parent, c.x, c.y, c.width, c.height,
+          c.override_redirect);
+      break;
+    }
+    case DestroyNotify:
+      e->xdestroywindow.event = TranslateWindow(e->xdestroywindow.event, false);
+      e->xdestroywindow.window =
+          TranslateWindow(e->xdestroywindow.window, false);
+      break;
+    case UnmapNotify:
+      e->xunmap.event = TranslateWindow(e->xunmap.event, true);
+      e->xunmap.window = TranslateWindow(e->xunmap.window, true);
+      break;
+    case MapNotify:
+      e->xmap.event = TranslateWindow(e->xmap.event, true);
+      e->xmap.window = TranslateWindow(e->xmap.window, true);
+      break;
+    case MapRequest:
+      e->xmaprequest.parent = TranslateWindow(e->xmaprequest.parent, true);
+      e->xmaprequest.window = TranslateWindow(e->xmaprequest.window, true);
+      break;
+    case ReparentNotify:
+      e->xreparent.event = TranslateWindow(e->xreparent.event, true);
+      e->xreparent.window = TranslateWindow(e->xreparent.window, true);
+      e->xreparent.parent = TranslateWindow(e->xreparent.parent, true);
+      break;
+    case ConfigureNotify:
+      e->xconfigure.event = TranslateWindow(e->xconfigure.event, true);
+      e->xconfigure.window = TranslateWindow(e->xconfigure.window, true);
+      e->xconfigure.above = TranslateWindow(e->xconfigure.above, true);
+      break;
+    case ConfigureRequest:
+      e->xconfigurerequest.parent =
+          TranslateWindow(e->xconfigurerequest.parent, true);
+      e->xconfigurerequest.window =
+          TranslateWindow(e->xconfigurerequest.window, true);
+      e->xconfigurerequest.above =
+          TranslateWindow(e->xconfigurerequest.above, true);
+      break;
+    case PropertyNotify:
+      e->xproperty.window = TranslateWindow(e->xproperty.window, true);
+      e->xproperty.atom = TranslateAtom(e->xproperty.atom);
+      break;
+    case ClientMessage:
+      e->xclient.window = TranslateWindow(e->xclient.window, true);
+      e->xclient.message_type = TranslateAtom(e->xclient.message_type);
+      break;
+    case MappingNotify:
+      break;
+    default:
+      e->xany.window = TranslateWindow(e->xany.window, true);
+  }
+}
+
+void ReplayTranslator::Forget(Window recorded) {
+  auto i = windows_.find(recorded);
+  if (i == windows_.end()) {
+    return;
+  }
+  if (stand_ins_.erase(i->second)) {
+    XDestroyWindow(display_, i->second);
+  }
+  windows_.erase(i);
+}
+
+Window ReplayTranslator::CreateStandIn(
+    Window recorded, Window parent, int x, int y, int width, int height,
+    bool override_redirect) {
+  XSetWindowAttributes attrs;
+  attrs.override_redirect = override_redirect;
+  const Window w = XCreateWindow(
+      display_, parent, x, y,
+      ::std::max(width, 1), ::std::max(height, 1), 0, CopyFromParent,
+      InputOutput, CopyFromParent, CWOverrideRedirect, &attrs);
+  windows_[recorded] = w;
+  stand_ins_.insert(w);
+  return w;
+}
@@ -0,0 +1,145 @@
+#ifndef RECORDING_HPP
+#define RECORDING_HPP
+
+extern "C" {
+#include <X11/Xlib.h>
+}
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// One record of an event recording. Records are of a fixed size, so that a
+// recording can be mapped into memory and indexed like an array.
+struct EventRecord {
+  enum Type : uint32_t {
+    // The first record of every recording.
+    HEADER,
+    // An event read from the display and dispatched.
+    EVENT,
+    // A MotionNotify the event before it was coalesced with while dispatching.
+    COALESCED_EVENT,
+    // A client window was framed.
+    FRAME,
+    // An atom of the recording display, so that replays can intern it again.
+    ATOM,
+    // The drag timer ticked.
+    DRAG_TICK,
+    // The batch of everything since the previous BATCH_END was finished.
+    BATCH_END,
+    // The wait for a deferred relayout ended.
+    RELAYOUT_TICK,
+  };
+
+  uint32_t type;
+  // sizeof(EventRecord) of the recording build. Recordings are only replayed
+  // by builds with the same record layout.
+  uint32_t size;
+  // Time since the start of the recording.
+  uint64_t time_ns;
+  union {
+    struct {
+      char magic[8];
+      Window root;
+    } header;
+    XEvent event;
+    struct {
+      Window window;
+      Window frame;
+    } frame;
+    struct {
+      Atom atom;
+      char name[64];
+    } atom;
+  };
+};
+
+// Writes an event recording. Records are buffered for the current batch, and
+// written out when it ends.
+class EventRecorder {
+ public:
+  // Creates or truncates the recording at path. Returns nullptr on failure.
+  static ::std::unique_ptr<EventRecorder> Create(
+      const ::std::string& path, Window root);
+  ~EventRecorder();
+
+  void RecordAtom(Atom atom, const char* name);
+  void RecordEvent(const XEvent& e, bool coalesced);
+  void RecordFrame(Window w, Window frame);
+  void RecordDragTick();
+  void RecordRelayoutTick();
+  void RecordBatchEnd();
+
+ private:
+  explicit EventRecorder(int fd);
+  // Appends a record of the given type, with its payload zeroed.
+  EventRecord* Append(EventRecord::Type type);
+  // Writes out the buffered records.
+  void Flush();
+
+  const int fd_;
+  const ::std::chrono::steady_clock::time_point start_;
+  ::std::vector<EventRecord> pending_;
+};
+
+// An event recording mapped into memory.
+class Recording {
+ public:
+  // Maps the recording at path. Returns nullptr if it can't be read or wasn't
+  // written by this build.
+  static ::std::unique_ptr<Recording> Open(const ::std::string& path);
+  ~Recording();
+
+  size_t size() const { return size_; }
+  const EventRecord& operator[](size_t i) const { return records_[i]; }
+
+ private:
+  Recording(const EventRecord* records, size_t size);
+
+  const EventRecord* const records_;
+  const size_t size_;
+};
+
+// Maps the windows and atoms of a recording to a live display. Recorded client
+// windows are replaced by stand-in windows of the same geometry, created when
+// they first appear; frames are mapped to the frames of their stand-ins as
+// they are created.
+class ReplayTranslator {
+ public:
+  ReplayTranslator(Display* display, Window recorded_root);
+  // Destroys the stand-in windows that are still around.
+  ~ReplayTranslator();
+
+  void AddAtom(Atom recorded, const char* name);
+  // Maps a recorded window created by the window manager itself to its live
+  // counterpart.
+  void AddWindow(Window recorded, Window live);
+  // Returns the live counterpart of a recorded window. An unknown window gets
+  // a stand-in if create is set, and is None otherwise.
+  Window TranslateWindow(Window recorded, bool create);
+  // Translates the windows and atoms of e in place, making it an event of the
+  // live display.
+  void Translate(XEvent* e);
+  // Destroys the stand-in of a recorded window that was destroyed, whose ID
+  // may then be reused.
+  void Forget(Window recorded);
+
+ private:
+  // Creates a stand-in for a recorded window, as a child of the live window
+  // parent.
+  Window CreateStandIn(
+      Window recorded, Window parent, int x, int y, int width, int height,
+      bool override_redirect);
+  Atom TranslateAtom(Atom recorded) const;
+
+  Display* const display_;
+  ::std::unordered_map<Window, Window> windows_;
+  ::std::unordered_map<Atom, Atom> atoms_;
+  // Live stand-in windows, which unlike frames are ours to destroy.
+  ::std::unordered_set<Window> stand_ins_;
+};
+
+#endif
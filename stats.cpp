@@ -0,0 +1,157 @@
+#include "stats.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include <glog/logging.h>
+#include "ipc.hpp"
+
+using ::std::chrono::steady_clock;
+using ::std::string;
+
+Stats* Stats::instance_ = nullptr;
+
+void StatsEntry::Add(uint64_t ns, uint64_t requests, uint64_t round_trips) {
+  ++count;
+  total_ns += ns;
+  max_ns = ::std::max(max_ns, ns);
+  this->requests += requests;
+  this->round_trips += round_trips;
+  size_t bucket = 0;
+  for (uint64_t us = ns / 1000; us > 0 && bucket + 1 < BUCKET_COUNT;
+       us >>= 1) {
+    ++bucket;
+  }
+  ++buckets[bucket];
+}
+
+uint64_t StatsEntry::PercentileUs(double percentile) const {
+  const double rank = count * percentile / 100;
+  uint64_t seen = 0;
+  for (size_t i = 0; i + 1 < BUCKET_COUNT; ++i) {
+    seen += buckets[i];
+    if (seen > 0 && seen >= rank) {
+      return ::std::min(uint64_t(1) << i, (max_ns + 999) / 1000);
+    }
+  }
+  return (max_ns + 999) / 1000;
+}
+
+Stats::Stats(Display* display)
+    : display_(CHECK_NOTNULL(display)),
+      round_trips_(0) {
+  CHECK(instance_ == nullptr) << "Only one Stats may exist at a time";
+  instance_ = this;
+  previous_after_function_ = XSetAfterFunction(display_, &Stats::OnRequests);
+}
+
+Stats::~Stats() {
+  // The display may already be closed, so the after function is left in
+  // place, and disarmed.
+  instance_ = nullptr;
+}
+
+int Stats::OnRequests(Display* display) {
+  // An Xlib call that waited for a reply has read it before returning, so the
+  // last request the server is known to have processed is the one just sent.
+  // Calls that don't wait leave it behind.
+  Stats* stats = instance_;
+  if (stats == nullptr || display != stats->display_) {
+    return 0;
+  }
+  if (LastKnownRequestProcessed(display) == XNextRequest(display) - 1) {
+    ++stats->round_trips_;
+  }
+  return stats->previous_after_function_ != nullptr ?
+      stats->previous_after_function_(display) : 0;
+}
+
+StatsEntry* Stats::Entry(const string& group, const string& name) {
+  return &groups_[group][name];
+}
+
+Stats::Scope::Scope(Stats* stats, StatsEntry* entry)
+    : stats_(stats),
+      entry_(entry),
+      start_(steady_clock::now()),
+      start_request_(XNextRequest(stats->display_)),
+      start_round_trips_(stats->round_trips_) {
+}
+
+Stats::Scope::~Scope() {
+  const uint64_t ns = ::std::chrono::duration_cast<::std::chrono::nanoseconds>(
+      steady_clock::now() - start_).count();
+  entry_->Add(
+      ns,
+      XNextRequest(stats_->display_) - start_request_,
+      stats_->round_trips_ - start_round_trips_);
+}
+
+void Stats::Reset() {
+  for (auto& group : groups_) {
+    for (auto& entry : group.second) {
+      entry.second = StatsEntry();
+    }
+  }
+}
+
+string Stats::ToJson() const {
+  ::std::ostringstream out;
+  out << "{";
+  bool first_group = true;
+  for (const auto& group : groups_) {
+    out << (first_group ? "" : ",") << JsonString(group.first) << ":{";
+    first_group = false;
+    bool first = true;
+    for (const auto& i : group.second) {
+      const StatsEntry& entry = i.second;
+      if (entry.count == 0) {
+        continue;
+      }
+      out << (first ? "" : ",") << JsonString(i.first)
+          << ":{\"count\":" << entry.count
+          << ",\"total_us\":" << entry.total_ns / 1000
+          << ",\"p50_us\":" << entry.PercentileUs(50)
+          << ",\"p99_us\":" << entry.PercentileUs(99)
+          << ",\"max_us\":" << entry.max_ns / 1000
+          << ",\"requests\":" << entry.requests
+          << ",\"round_trips\":" << entry.round_trips
+          << "}";
+      first = false;
+    }
+    out << "}";
+  }
+  out << "}";
+  return out.str();
+}
+
+string Stats::ToText() const {
+  string text;
+  char line[256];
+  snprintf(
+      line, sizeof(line), "%-10s %-32s %8s %10s %8s %8s %8s %9s %9s\n",
+      "group", "name", "count", "total_ms", "p50_us", "p99_us", "max_us",
+      "req/op", "rtt/op");
+  text += line;
+  for (const auto& group : groups_) {
+    for (const auto& i : group.second) {
+      const StatsEntry& entry = i.second;
+      if (entry.count == 0) {
+        continue;
+      }
+      // Traffic is averaged, as a slow binding is judged by a single press.
+      snprintf(
+          line, sizeof(line),
+          "%-10s %-32s %8llu %10.3f %8llu %8llu %8llu %9.1f %9.1f\n",
+          group.first.c_str(), i.first.c_str(),
+          static_cast<unsigned long long>(entry.count),
+          entry.total_ns / 1e6,
+          static_cast<unsigned long long>(entry.PercentileUs(50)),
+          static_cast<unsigned long long>(entry.PercentileUs(99)),
+          static_cast<unsigned long long>(entry.max_ns / 1000),
+          static_cast<double>(entry.requests) / entry.count,
+          static_cast<double>(entry.round_trips) / entry.count);
+      text += line;
+    }
+  }
+  return text;
+}
@@ -0,0 +1,90 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+extern "C" {
+#include <X11/Xlib.h>
+}
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+
+// Latency and X protocol cost of one kind of work, such as handling one type of
+// event or running one key binding.
+struct StatsEntry {
+  // Latencies are bucketed by powers of two: bucket i counts samples shorter
+  // than 2^i microseconds, and the last bucket all longer ones.
+  static const size_t BUCKET_COUNT = 24;
+
+  uint64_t count = 0;
+  uint64_t total_ns = 0;
+  uint64_t max_ns = 0;
+  // Requests issued, from XNextRequest() deltas.
+  uint64_t requests = 0;
+  // Requests whose replies were waited for.
+  uint64_t round_trips = 0;
+  uint64_t buckets[BUCKET_COUNT] = {};
+
+  void Add(uint64_t ns, uint64_t requests, uint64_t round_trips);
+  // Returns the upper bound of the histogram bucket holding the given
+  // percentile, in microseconds, or the maximum if that is lower.
+  uint64_t PercentileUs(double percentile) const;
+};
+
+// Where the window manager spends its time, and how many requests and round
+// trips each kind of work costs. Entries are grouped, e.g. by event type, key
+// binding or IPC command.
+//
+// Round trips are counted by an Xlib after function on the display, which sees
+// every Xlib call that issues a request, and so only one Stats may exist at a
+// time. Round trips of XSync() and of direct XCB calls go uncounted.
+class Stats {
+ public:
+  explicit Stats(Display* display);
+  ~Stats();
+
+  // Returns the entry named name in group, creating it on first use. Entries
+  // stay at the same address for the lifetime of the Stats, so hot paths can
+  // look them up once.
+  StatsEntry* Entry(const ::std::string& group, const ::std::string& name);
+
+  // Measures the time and X traffic of its lifetime into an entry. Scopes may
+  // nest, in which case the outer entry includes the inner ones.
+  class Scope {
+   public:
+    Scope(Stats* stats, StatsEntry* entry);
+    ~Scope();
+
+   private:
+    Stats* const stats_;
+    StatsEntry* const entry_;
+    const ::std::chrono::steady_clock::time_point start_;
+    const unsigned long start_request_;
+    const uint64_t start_round_trips_;
+  };
+
+  // Clears all entries, keeping them at their addresses.
+  void Reset();
+  // Returns all entries with samples, as a JSON object of groups mapping names
+  // to entries.
+  ::std::string ToJson() const;
+  // Returns all entries with samples as a table for logging, one per line.
+  ::std::string ToText() const;
+
+ private:
+  // Xlib after function, called once for every Xlib call issuing requests.
+  static int OnRequests(Display* display);
+
+  // The instance OnRequests() counts for.
+  static Stats* instance_;
+
+  Display* const display_;
+  // After function installed before ours.
+  int (*previous_after_function_)(Display*);
+  // Round trips made so far.
+  uint64_t round_trips_;
+  ::std::map<::std::string, ::std::map<::std::string, StatsEntry>> groups_;
+};
+
+#endif
@@ -0,0 +1,186 @@
+#include "trace.hpp"
+extern "C" {
+#include <pthread.h>
+#include <signal.h>
+}
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <thread>
+
+using ::std::atomic;
+using ::std::chrono::milliseconds;
+using ::std::chrono::system_clock;
+using ::std::mutex;
+using ::std::unique_lock;
+
+// A message in the ring buffer.
+struct TraceSlot {
+  TraceLevel level;
+  system_clock::time_point time;
+  size_t length;
+  char text[240];
+};
+
+namespace {
+
+// Returns the threshold named by the BASIC_WM_TRACE environment variable.
+TraceLevel InitialTraceThreshold() {
+  static const struct {
+    const char* name;
+    TraceLevel level;
+  } LEVEL_NAMES[] = {
+      {"debug", TraceLevel::DEBUG},
+      {"info", TraceLevel::INFO},
+      {"warning", TraceLevel::WARNING},
+      {"error", TraceLevel::ERROR},
+      {"off", TraceLevel::OFF},
+  };
+  const char* name = getenv("BASIC_WM_TRACE");
+  if (name != nullptr) {
+    for (const auto& level : LEVEL_NAMES) {
+      if (strcasecmp(name, level.name) == 0) {
+        return level.level;
+      }
+    }
+  }
+  return TraceLevel::INFO;
+}
+
+// Single producer, single consumer ring buffer of messages, drained by a
+// background thread started on first use.
+class TraceBuffer {
+ public:
+  ~TraceBuffer() {
+    if (!thread_.joinable()) {
+      return;
+    }
+    stopping_ = true;
+    wakeup_.notify_one();
+    thread_.join();
+  }
+
+  // Returns the next free slot, or nullptr if the buffer is full.
+  TraceSlot* Reserve() {
+    if (!thread_.joinable()) {
+      Start();
+    }
+    const size_t tail = tail_.load(::std::memory_order_relaxed);
+    if (tail - head_.load(::std::memory_order_acquire) == SLOT_COUNT) {
+      dropped_.fetch_add(1, ::std::memory_order_relaxed);
+      return nullptr;
+    }
+    return &slots_[tail % SLOT_COUNT];
+  }
+
+  // Hands the slot last returned by Reserve() over to the background thread.
+  void Commit() {
+    tail_.store(
+        tail_.load(::std::memory_order_relaxed) + 1,
+        ::std::memory_order_release);
+    // Only pay for a wakeup if the background thread is asleep. A wakeup lost to
+    // a race is made up for by the bounded wait in Drain().
+    if (sleeping_.load(::std::memory_order_relaxed)) {
+      wakeup_.notify_one();
+    }
+  }
+
+ private:
+  static const size_t SLOT_COUNT = 1024;
+
+  void Start() {
+    // Start the thread with all signals blocked, so that signals meant for
+    // the event loop's signalfd can't be delivered to it.
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    thread_ = ::std::thread([this] { Drain(); });
+    pthread_sigmask(SIG_SETMASK, &old, nullptr);
+  }
+
+  // Background thread: writes out committed messages until destruction.
+  void Drain() {
+    for (;;) {
+      const size_t head = head_.load(::std::memory_order_relaxed);
+      const size_t tail = tail_.load(::std::memory_order_acquire);
+      if (head == tail) {
+        if (stopping_) {
+          break;
+        }
+        unique_lock<mutex> lock(mutex_);
+        sleeping_ = true;
+        wakeup_.wait_for(lock, milliseconds(50), [this, tail] {
+          return stopping_ || tail_.load(::std::memory_order_acquire) != tail;
+        });
+        sleeping_ = false;
+        continue;
+      }
+      for (size_t i = head; i != tail; ++i) {
+        Write(slots_[i % SLOT_COUNT]);
+      }
+      head_.store(tail, ::std::memory_order_release);
+      const size_t dropped = dropped_.exchange(0, ::std::memory_order_relaxed);
+      if (dropped) {
+        fprintf(stderr, "W trace buffer full, dropped %zu messages\n", dropped);
+      }
+      fflush(stderr);
+    }
+  }
+
+  static void Write(const TraceSlot& slot) {
+    static const char LEVEL_LETTERS[] = "DIWE";
+    const time_t t = system_clock::to_time_t(slot.time);
+    const long us = ::std::chrono::duration_cast<::std::chrono::microseconds>(
+        slot.time.time_since_epoch()).count() % 1000000;
+    tm local;
+    localtime_r(&t, &local);
+    fprintf(
+        stderr,
+        "%c %02d:%02d:%02d.%06ld %.*s\n",
+        LEVEL_LETTERS[static_cast<int>(slot.level)],
+        local.tm_hour, local.tm_min, local.tm_sec, us,
+        static_cast<int>(slot.length), slot.text);
+  }
+
+  TraceSlot slots_[SLOT_COUNT];
+  // Index of the next slot to drain, owned by the background thread.
+  atomic<size_t> head_{0};
+  // Index of the next slot to fill, owned by the producer.
+  atomic<size_t> tail_{0};
+  atomic<size_t> dropped_{0};
+  atomic<bool> sleeping_{false};
+  atomic<bool> stopping_{false};
+  mutex mutex_;
+  ::std::condition_variable wakeup_;
+  ::std::thread thread_;
+};
+
+TraceBuffer trace_buffer;
+
+}  // namespace
+
+TraceLevel trace_threshold = InitialTraceThreshold();
+
+TraceMessage::TraceMessage(TraceLevel level)
+    : slot_(trace_buffer.Reserve()),
+      buffer_(
+          slot_ ? slot_->text : nullptr,
+          slot_ ? slot_->text + sizeof(slot_->text) : nullptr),
+      stream_(&buffer_) {
+  if (slot_) {
+    slot_->level = level;
+    slot_->time = system_clock::now();
+  }
+}
+
+TraceMessage::~TraceMessage() {
+  if (slot_) {
+    slot_->length = buffer_.size();
+    trace_buffer.Commit();
+  }
+}
@@ -0,0 +1,67 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <cstddef>
+#include <ostream>
+#include <streambuf>
+
+// Severity of a trace message.
+enum class TraceLevel {
+  DEBUG,
+  INFO,
+  WARNING,
+  ERROR,
+  // Only used as a threshold, to disable tracing altogether.
+  OFF,
+};
+
+// Messages below this level are discarded. Initialized from the BASIC_WM_TRACE
+// environment variable ("debug", "info", "warning", "error" or "off"), and
+// INFO if it is unset.
+extern TraceLevel trace_threshold;
+
+// Whether messages of the given level are recorded.
+inline bool TraceEnabled(TraceLevel level) {
+  return level >= trace_threshold;
+}
+
+// A trace message under construction. It is formatted directly into a slot of
+// a lock-free ring buffer, and handed over to a background thread that writes
+// it to stderr when the TraceMessage is destroyed. If the ring buffer is full,
+// the message is dropped rather than making the caller wait. Messages must
+// only be traced from the main thread.
+class TraceMessage {
+ public:
+  explicit TraceMessage(TraceLevel level);
+  ~TraceMessage();
+
+  ::std::ostream& stream() { return stream_; }
+
+ private:
+  // Stream buffer writing into a fixed-size character array, truncating what
+  // doesn't fit.
+  class Buffer : public ::std::streambuf {
+   public:
+    Buffer(char* begin, char* end) {
+      setp(begin, end);
+    }
+    size_t size() const {
+      return pptr() - pbase();
+    }
+  };
+
+  // Slot the message is written into, or nullptr if it is dropped.
+  struct TraceSlot* const slot_;
+  Buffer buffer_;
+  ::std::ostream stream_;
+};
+
+// Usage: TRACE(INFO) << "Framed window " << w;
+//
+// The message is only formatted, and its operands only evaluated, if the level
+// is enabled, so disabled trace statements cost a single comparison.
+#define TRACE(level) \
+  if (!TraceEnabled(TraceLevel::level)) ; \
+  else TraceMessage(TraceLevel::level).stream()
+
+#endif
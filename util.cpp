@@ -8,51 +8,59 @@ using ::std::vector;
 using ::std::pair;
 using ::std::ostringstream;
 
-string ToString(const XEvent& e) {
-  static const char* const X_EVENT_TYPE_NAMES[] = {
-      "",
-      "",
-      "KeyPress",
-      "KeyRelease",
-      "ButtonPress",
-      "ButtonRelease",
-      "MotionNotify",
-      "EnterNotify",
-      "LeaveNotify",
-      "FocusIn",
-      "FocusOut",
-      "KeymapNotify",
-      "Expose",
-      "GraphicsExpose",
-      "NoExpose",
-      "VisibilityNotify",
-      "CreateNotify",
-      "DestroyNotify",
-      "UnmapNotify",
-      "MapNotify",
-      "MapRequest",
-      "ReparentNotify",
-      "ConfigureNotify",
-      "ConfigureRequest",
-      "GravityNotify",
-      "ResizeRequest",
-      "CirculateNotify",
-      "CirculateRequest",
-      "PropertyNotify",
-      "SelectionClear",
-      "SelectionRequest",
-      "SelectionNotify",
-      "ColormapNotify",
-      "ClientMessage",
-      "MappingNotify",
-      "GeneralEvent",
-  };
+// Names of the core X event types, indexed by type.
+static const char* const X_EVENT_TYPE_NAMES[] = {
+    "",
+    "",
+    "KeyPress",
+    "KeyRelease",
+    "ButtonPress",
+    "ButtonRelease",
+    "MotionNotify",
+    "EnterNotify",
+    "LeaveNotify",
+    "FocusIn",
+    "FocusOut",
+    "KeymapNotify",
+    "Expose",
+    "GraphicsExpose",
+    "NoExpose",
+    "VisibilityNotify",
+    "CreateNotify",
+    "DestroyNotify",
+    "UnmapNotify",
+    "MapNotify",
+    "MapRequest",
+    "ReparentNotify",
+    "ConfigureNotify",
+    "ConfigureRequest",
+    "GravityNotify",
+    "ResizeRequest",
+    "CirculateNotify",
+    "CirculateRequest",
+    "PropertyNotify",
+    "SelectionClear",
+    "SelectionRequest",
+    "SelectionNotify",
+    "ColormapNotify",
+    "ClientMessage",
+    "MappingNotify",
+    "GeneralEvent",
+};
 
-  if (e.type < 2 || e.type >= LASTEvent) {
+string XEventTypeToString(int type) {
+  if (type < 2 || type >= LASTEvent) {
     ostringstream out;
-    out << "Unknown (" << e.type << ")";
+    out << "Unknown (" << type << ")";
     return out.str();
   }
+  return X_EVENT_TYPE_NAMES[type];
+}
+
+string ToString(const XEvent& e) {
+  if (e.type < 2 || e.type >= LASTEvent) {
+    return XEventTypeToString(e.type);
+  }
 
   // 1. Compile properties we care about.
   vector<pair<string, string>> properties;
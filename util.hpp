@@ -98,6 +98,9 @@ template <typename T>
 // Returns a string describing an X event for debugging purposes.
 extern ::std::string ToString(const XEvent& e);
 
+// Returns the name of an X event type.
+extern ::std::string XEventTypeToString(int type);
+
 // Returns a string describing an X window configuration value mask.
 extern ::std::string XConfigureWindowValueMaskToString(unsigned long value_mask);
 
@@ -1,21 +1,123 @@
 #include "window_manager.hpp"
 extern "C" {
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <X11/Xlib-xcb.h>
 #include <X11/Xutil.h>
+#include <X11/extensions/Xrandr.h>
+#include <xcb/xcb.h>
 }
+#include <cmath>
+#include <csignal>
 #include <cstring>
+#include <sstream>
 #include <X11/Xatom.h>
 #include <algorithm>
 #include <glog/logging.h>
+#include "process.hpp"
+#include "trace.hpp"
 #include "util.hpp"
-#include <iostream>
 using ::std::max;
 using ::std::mutex;
 using ::std::string;
 using ::std::unique_ptr;
+using ::std::vector;
 
 bool WindowManager::wm_detected_;
 mutex WindowManager::wm_detected_mutex_;
 
+// Actions key bindings can be bound to, by name.
+const WindowManager::KeyAction WindowManager::KEY_ACTIONS[] = {
+    {"close", &WindowManager::CloseWindow, true},
+    {"resize", &WindowManager::ResizeWindow, true},
+    {"swap", &WindowManager::SwapWindow, true},
+    {"focus_next", &WindowManager::FocusNextWindow, false},
+    {"focus", &WindowManager::FocusWindow, true},
+    {"tile", &WindowManager::TileWindows, false},
+    {"layout", &WindowManager::SetLayout, false},
+    {"spawn", &WindowManager::SpawnProgram, false},
+    {"restart", &WindowManager::RestartWindowManager, false},
+    {"workspace", &WindowManager::ShowWorkspace, false},
+    {"move_to_workspace", &WindowManager::MoveToWorkspace, true},
+};
+
+// Commands accepted on the IPC socket, and the actions implementing them.
+// Commands of actions that need a client take the client window as their
+// first argument, in decimal or hexadecimal. query-clients is handled apart.
+static const struct {
+  const char* command;
+  const char* action;
+} IPC_COMMANDS[] = {
+    {"tile", "tile"},
+    {"layout", "layout"},
+    {"swap", "swap"},
+    {"focus", "focus"},
+    {"resize-by", "resize"},
+    {"workspace", "workspace"},
+    {"move-to-workspace", "move_to_workspace"},
+    {"close", "close"},
+    {"spawn", "spawn"},
+    {"restart", "restart"},
+};
+
+// Names of the atoms in WindowManager::atoms_, in AtomName order.
+static const char* const ATOM_NAMES[] = {
+    "WM_PROTOCOLS",
+    "WM_DELETE_WINDOW",
+    "_NET_WM_WINDOW_TYPE",
+    "_NET_WM_WINDOW_TYPE_DOCK",
+    "_NET_WM_WINDOW_TYPE_DESKTOP",
+    "_BASIC_WM_STATE",
+    "_NET_NUMBER_OF_DESKTOPS",
+    "_NET_CURRENT_DESKTOP",
+    "_NET_DESKTOP_NAMES",
+    "UTF8_STRING",
+    "_NET_SUPPORTED",
+    "_NET_SUPPORTING_WM_CHECK",
+    "_NET_WM_NAME",
+    "_NET_CLIENT_LIST",
+    "_NET_ACTIVE_WINDOW",
+    "_NET_WORKAREA",
+};
+
+const WindowManager::AtomName WindowManager::SUPPORTED_ATOMS[] = {
+    NET_SUPPORTED,
+    NET_SUPPORTING_WM_CHECK,
+    NET_WM_NAME,
+    NET_CLIENT_LIST,
+    NET_ACTIVE_WINDOW,
+    NET_WORKAREA,
+    NET_NUMBER_OF_DESKTOPS,
+    NET_CURRENT_DESKTOP,
+    NET_DESKTOP_NAMES,
+    NET_WM_WINDOW_TYPE,
+    NET_WM_WINDOW_TYPE_DOCK,
+    NET_WM_WINDOW_TYPE_DESKTOP,
+};
+
+// Version of the _BASIC_WM_STATE format, which is the version followed by the
+// client, frame, weight, monitor and workspace of every tile, in tile order.
+// Weights are stored as billionths of the total weight of the layout.
+static const long STATE_VERSION = 3;
+static const double STATE_WEIGHT_SCALE = 1e9;
+
+// Longest a deferred relayout waits in total, so that windows mapped in a
+// steady stream still get tiled.
+static const int MAX_RELAYOUT_DELAY_MS = 250;
+
+// Returns the atoms in a property reply, which are none if the property is
+// missing or isn't a list. XCB hands out 32 bit atoms, whereas Xlib's Atom is
+// a long.
+static vector<Atom> AtomsOf(xcb_get_property_reply_t* reply) {
+  vector<Atom> atoms;
+  if (reply != nullptr && reply->format == 32) {
+    const uint32_t* values =
+        static_cast<const uint32_t*>(xcb_get_property_value(reply));
+    atoms.assign(values, values + xcb_get_property_value_length(reply) / 4);
+  }
+  return atoms;
+}
+
 
 
 unique_ptr<WindowManager> WindowManager::Create(const string& display_str) {
@@ -31,19 +133,61 @@ unique_ptr<WindowManager> WindowManager::Create(const string& display_str) {
   return unique_ptr<WindowManager>(new WindowManager(display));
 }
 
-struct Tuple {
-    int x;
-    int y;
-};
-
 WindowManager::WindowManager(Display* display)
     : display_(CHECK_NOTNULL(display)),
+      stats_(display_),
+      replaying_(false),
+      ipc_server_(
+          &event_loop_,
+          [this](const vector<string>& commands) {
+            return HandleIpcCommands(commands);
+          }),
+      bar_(None),
       root_(DefaultRootWindow(display_)),
-      WM_PROTOCOLS(XInternAtom(display_, "WM_PROTOCOLS", false)),
-      WM_DELETE_WINDOW(XInternAtom(display_, "WM_DELETE_WINDOW", false)) {
+      relayout_pending_(false),
+      relayout_timer_(-1),
+      current_workspace_(0),
+      check_window_(None),
+      client_list_published_(-1),
+      published_active_window_(None),
+      key_press_state_(0),
+      published_workarea_(0, 0, 0, 0),
+      restart_requested_(false),
+      randr_event_base_(-1),
+      config_path_(DefaultConfigPath()),
+      config_(LoadConfig(config_path_)),
+      inotify_fd_(-1),
+      numlock_mask_(0),
+      drag_window_(None),
+      drag_button_(0),
+      drag_pending_(false),
+      drag_timer_(-1),
+      drag_interval_ms_(16),
+      outline_resize_(false),
+      outline_visible_(false),
+      outline_gc_(nullptr) {
+  static_assert(
+      sizeof(ATOM_NAMES) / sizeof(ATOM_NAMES[0]) == ATOM_COUNT,
+      "ATOM_NAMES must name every AtomName");
+  CHECK(XInternAtoms(
+      display_,
+      const_cast<char**>(ATOM_NAMES),
+      ATOM_COUNT,
+      false,
+      atoms_));
+  for (int type = 0; type < LASTEvent; ++type) {
+    event_stats_[type] = stats_.Entry("event", XEventTypeToString(type));
+  }
+  UpdateMonitors();
 }
 
 WindowManager::~WindowManager() {
+  if (inotify_fd_ >= 0) {
+    close(inotify_fd_);
+  }
+  if (outline_gc_ != nullptr) {
+    XFreeGC(display_, outline_gc_);
+  }
   XCloseDisplay(display_);
 }
 
@@ -65,9 +209,32 @@ void WindowManager::Run() {
     }
   }
   XSetErrorHandler(&WindowManager::OnXError);
-  //   c. Grab X server to prevent windows from changing under us.
+  //   a. Grab key and button bindings once on the root window, so that they
+  //   work in any window and framing a window needs no grabs of its own.
+  UpdateNumLockMask();
+  ResolveKeyBindings();
+  GrabBindings();
+  //   b. Get told when the screen or its outputs are reconfigured, so that the
+  //   cached monitor geometry stays valid.
+  int randr_error_base;
+  if (XRRQueryExtension(display_, &randr_event_base_, &randr_error_base)) {
+    XRRSelectInput(
+        display_, root_, RRScreenChangeNotifyMask | RRCrtcChangeNotifyMask);
+  } else {
+    randr_event_base_ = -1;
+    LOG(WARNING) << "RandR is unavailable, screen size changes are ignored";
+  }
+  UpdateMonitors();
+  UpdateDragInterval();
+  //   c. Pick up where a previous instance left off, and tell pagers about
+  //   our workspaces.
+  ReadCurrentWorkspace();
+  PublishWorkspaces();
+  PublishSupport();
+  //   d. Grab X server to prevent windows from changing under us.
   XGrabServer(display_);
-  //   d. Reparent existing top-level windows.
+  //   e. Reparent existing top-level windows, and take over the frames of a
+  //   previous instance we were restarted from.
   //     i. Query existing top-level windows.
   Window returned_root, returned_parent;
   Window* top_level_windows;
@@ -81,82 +248,371 @@ void WindowManager::Run() {
       &num_top_level_windows));
   CHECK_EQ(returned_root, root_);
   //     ii. Frame each top-level window.
-  for (unsigned int i = 0; i < num_top_level_windows; ++i) {
-    Frame(top_level_windows[i], true);
-  }
+  AdoptWindows(top_level_windows, num_top_level_windows, ReadSavedState());
   //     iii. Free top-level window array.
   XFree(top_level_windows);
-  //   e. Ungrab X server.
+  //   f. Ungrab X server.
   XUngrabServer(display_);
 
-  // 2. Main event loop.
-  for (;;) {
-    // 1. Get next event.
-    //
-    WindowManager::getCursor(display_);
-    XEvent e;
-    XNextEvent(display_, &e);
-    LOG(INFO) << "Received event: " << ToString(e);
+  // 2. Serve the display, or replay a recorded session on it instead.
+  const char* replay_path = getenv("BASIC_WM_REPLAY");
+  if (replay_path != nullptr && *replay_path != '\0') {
+    ReplayRecording(replay_path);
+  } else {
+    ServeDisplay();
+  }
 
-    // 2. Dispatch event.
-    switch (e.type) {
-      case CreateNotify:
-        OnCreateNotify(e.xcreatewindow);
-        break;
-      case DestroyNotify:
-        OnDestroyNotify(e.xdestroywindow);
-        break;
-      case ReparentNotify:
-        OnReparentNotify(e.xreparent);
-        break;
-      case MapNotify:
-        OnMapNotify(e.xmap);
-        break;
-      case UnmapNotify:
-        OnUnmapNotify(e.xunmap);
-        break;
-      case ConfigureNotify:
-        OnConfigureNotify(e.xconfigure);
-        break;
-      case MapRequest:
-        OnMapRequest(e.xmaprequest);
-        break;
-      case ConfigureRequest:
-        OnConfigureRequest(e.xconfigurerequest);
+  // 3. Leave clients framed for the next instance when restarting, or hand
+  // them back to the root window. The next instance makes its own check
+  // window, so ours must not be retained.
+  XDeleteProperty(display_, root_, atoms_[NET_SUPPORTING_WM_CHECK]);
+  XDestroyWindow(display_, check_window_);
+  if (restart_requested_) {
+    SaveState();
+  } else {
+    ReleaseClients();
+  }
+}
+
+void WindowManager::ServeDisplay() {
+  // X events, timers, signals and any other sources are multiplexed over one
+  // epoll instance, and the loop sleeps until one of them is ready.
+  event_loop_.Watch(ConnectionNumber(display_), [this] { ProcessXEvents(); });
+  // Xlib may read events into its queue while waiting for a reply, without
+  // the connection becoming readable again, so drain the queue before every
+  // sleep too.
+  event_loop_.SetPrepareCallback([this] { ProcessXEvents(); });
+  event_loop_.HandleSignal(SIGINT, [this] { event_loop_.Stop(); });
+  event_loop_.HandleSignal(SIGTERM, [this] { event_loop_.Stop(); });
+  // Launched processes are reaped as they exit, so the loop never waits for
+  // them. Reap once up front for any that exited before the handler was set.
+  event_loop_.HandleSignal(SIGCHLD, [] { ReapChildren(); });
+  ReapChildren();
+  // The configuration is reloaded on SIGHUP, and whenever the file is saved.
+  event_loop_.HandleSignal(SIGHUP, [this] { ReloadConfig(); });
+  // Statistics are logged on SIGUSR1.
+  event_loop_.HandleSignal(SIGUSR1, [this] {
+    LOG(INFO) << "Statistics:\n" << stats_.ToText();
+  });
+  WatchConfig();
+  // Scripts control us through a socket, whose path launched programs find in
+  // the environment.
+  const string socket_path = IpcServer::DefaultPath(XDisplayString(display_));
+  if (ipc_server_.Listen(socket_path)) {
+    setenv("BASIC_WM_SOCKET", socket_path.c_str(), true);
+  }
+  // Record the session for replays, if asked to.
+  const char* record_path = getenv("BASIC_WM_RECORD");
+  if (record_path != nullptr && *record_path != '\0') {
+    recorder_ = EventRecorder::Create(record_path, root_);
+  }
+  if (recorder_) {
+    for (int i = 0; i < ATOM_COUNT; ++i) {
+      recorder_->RecordAtom(atoms_[i], ATOM_NAMES[i]);
+    }
+  }
+  event_loop_.Run();
+  LOG(INFO) << "Exiting event loop";
+  recorder_.reset();
+}
+
+void WindowManager::ReplayRecording(const string& path) {
+  const unique_ptr<Recording> recording = Recording::Open(path);
+  if (!recording) {
+    return;
+  }
+  LOG(INFO) << "Replaying " << path;
+  replaying_ = true;
+  ReplayTranslator translator(display_, (*recording)[0].header.root);
+  const ::std::chrono::steady_clock::time_point start =
+      ::std::chrono::steady_clock::now();
+  size_t events = 0;
+  for (size_t i = 1; i < recording->size(); ++i) {
+    const EventRecord& record = (*recording)[i];
+    switch (record.type) {
+      case EventRecord::ATOM:
+        translator.AddAtom(record.atom.atom, record.atom.name);
         break;
-      case ButtonPress:
-        OnButtonPress(e.xbutton);
+      case EventRecord::EVENT: {
+        //   a. Coalesce motion the way it was when recorded, rather than with
+        //   whatever the display has queued.
+        XEvent e = record.event;
+        while (i + 1 < recording->size() &&
+               (*recording)[i + 1].type == EventRecord::COALESCED_EVENT) {
+          e = (*recording)[++i].event;
+        }
+        //   b. Dispatch it as an event of the live display.
+        translator.Translate(&e);
+        {
+          Stats::Scope scope(&stats_, EventStats(e.type));
+          DispatchEvent(e);
+        }
+        if (record.event.type == DestroyNotify) {
+          translator.Forget(record.event.xdestroywindow.window);
+        }
+        ++events;
         break;
-      case ButtonRelease:
-        OnButtonRelease(e.xbutton);
+      }
+      case EventRecord::FRAME: {
+        const Client* client =
+            FindClient(translator.TranslateWindow(record.frame.window, false));
+        if (client != nullptr && client->frame != None) {
+          translator.AddWindow(record.frame.frame, client->frame);
+        }
         break;
-      case MotionNotify:
-        // Skip any already pending motion events.
-        while (XCheckTypedWindowEvent(
-            display_, e.xmotion.window, MotionNotify, &e)) {}
-        OnMotionNotify(e.xmotion);
+      }
+      case EventRecord::DRAG_TICK:
+        if (drag_timer_ >= 0) {
+          OnDragTimer();
+        }
         break;
-      case KeyPress:
-        OnKeyPress(e.xkey);
+      case EventRecord::RELAYOUT_TICK:
+        if (relayout_timer_ >= 0) {
+          // The loop isn't running, so the timer itself never fires.
+          event_loop_.CancelTimer(relayout_timer_);
+          OnRelayoutTimer();
+        }
         break;
-      case KeyRelease:
-        OnKeyRelease(e.xkey);
+      case EventRecord::BATCH_END:
+        while (XPending(display_)) {
+          XEvent e;
+          XNextEvent(display_, &e);
+        }
+        FinishBatch();
         break;
-      default:
-        LOG(WARNING) << "Ignored event";
     }
   }
+  replaying_ = false;
+  const double recorded_s = (*recording)[recording->size() - 1].time_ns / 1e9;
+  const double replayed_s = ::std::chrono::duration<double>(
+      ::std::chrono::steady_clock::now() - start).count();
+  LOG(INFO) << "Replayed " << events << " events recorded over " << recorded_s
+            << " s in " << replayed_s << " s. Statistics:\n"
+            << stats_.ToText();
 }
 
-void WindowManager::Frame(Window w, bool was_created_before_window_manager) {
-  // Visual properties of the frame to create.
-  const unsigned int BORDER_WIDTH = 3;
-  const unsigned long BORDER_COLOR = 0xff0000;
-  const unsigned long BG_COLOR = 0x0000ff;
+void WindowManager::ProcessXEvents() {
+  // 1. Dispatch every event the server has sent so far.
+  while (XPending(display_)) {
+    XEvent e;
+    XNextEvent(display_, &e);
+    TRACE(DEBUG) << "Received event: " << ToString(e);
+    if (recorder_) {
+      recorder_->RecordEvent(e, false);
+    }
+    Stats::Scope scope(&stats_, EventStats(e.type));
+    DispatchEvent(e);
+  }
+  // 2. Apply what they changed.
+  FinishBatch();
+}
+
+void WindowManager::FinishBatch() {
+  // 1. Apply the layout changes the batch accumulated in one pass.
+  if (relayout_pending_) {
+    Relayout();
+  }
+  // 2. Let pagers and bars know about whatever the batch changed.
+  UpdateRootProperties();
+  // 3. Send everything the batch produced at once.
+  XFlush(display_);
+  if (recorder_) {
+    recorder_->RecordBatchEnd();
+  }
+}
+
+string WindowManager::HandleIpcCommands(const vector<string>& commands) {
+  // All commands of a message are applied before any relayout, so that a
+  // script rearranging many windows costs a single pass.
+  Stats::Scope scope(&stats_, stats_.Entry("handler", "HandleIpcCommands"));
+  string replies;
+  for (const string& command : commands) {
+    replies += HandleIpcCommand(command);
+    replies += '\n';
+  }
+  FinishBatch();
+  return replies;
+}
+
+string WindowManager::HandleIpcCommand(const string& command) {
+  // 1. Split into name, client window if the action needs one, and argument.
+  ::std::istringstream in(command);
+  string name;
+  in >> name;
+  if (name.empty()) {
+    return "{\"ok\":false,\"error\":\"empty command\"}";
+  }
+  if (name == "query-clients") {
+    return QueryClients();
+  }
+  if (name == "stats") {
+    string argument;
+    ::std::getline(in >> ::std::ws, argument);
+    return QueryStats(argument);
+  }
+  const KeyAction* action = nullptr;
+  for (const auto& c : IPC_COMMANDS) {
+    if (name == c.command) {
+      action = FindKeyAction(c.action);
+      break;
+    }
+  }
+  if (action == nullptr) {
+    return "{\"ok\":false,\"error\":" +
+        JsonString("unknown command " + name) + "}";
+  }
+  Window w = None;
+  if (action->needs_client) {
+    string window;
+    in >> window;
+    // Accept frames too, as that is what tools like xwininfo pick.
+    w = strtoul(window.c_str(), nullptr, 0);
+    const Client* client = FindClient(w);
+    if (client == nullptr) {
+      client = FindClientByFrame(w);
+    }
+    if (client == nullptr || client->frame == None) {
+      return "{\"ok\":false,\"error\":" +
+          JsonString("no client " + window) + "}";
+    }
+    w = client->window;
+  }
+  string argument;
+  ::std::getline(in >> ::std::ws, argument);
+  // 2. Run it like a key binding.
+  Stats::Scope scope(&stats_, stats_.Entry("command", name));
+  (this->*action->handler)(w, argument);
+  return "{\"ok\":true}";
+}
+
+string WindowManager::QueryClients() {
+  ::std::ostringstream out;
+  out << "{\"ok\":true,\"workspace\":" << current_workspace_ + 1
+      << ",\"clients\":[";
+  bool first = true;
+  for (Window w : client_list_) {
+    const Client& client = *CHECK_NOTNULL(clients_.Find(w));
+    out << (first ? "" : ",")
+        << "{\"window\":" << w
+        << ",\"frame\":" << client.frame
+        << ",\"x\":" << client.frame_pos.x
+        << ",\"y\":" << client.frame_pos.y
+        << ",\"width\":" << client.frame_size.width
+        << ",\"height\":" << client.frame_size.height
+        << ",\"monitor\":" << client.monitor
+        << ",\"workspace\":" << client.workspace + 1
+        << ",\"focused\":" << (&client == focus_.focused() ? "true" : "false")
+        << "}";
+    first = false;
+  }
+  out << "]}";
+  return out.str();
+}
+
+string WindowManager::QueryStats(const string& arg) {
+  const string reply = "{\"ok\":true,\"stats\":" + stats_.ToJson() + "}";
+  if (arg == "reset") {
+    stats_.Reset();
+  }
+  return reply;
+}
 
-  // We shouldn't be framing windows we've already framed.
-  CHECK(!clients_.count(w));
+StatsEntry* WindowManager::EventStats(int type) {
+  if (type < LASTEvent) {
+    return event_stats_[type];
+  }
+  // Extension events are rare enough to be looked up by name.
+  if (randr_event_base_ >= 0) {
+    if (type == randr_event_base_ + RRScreenChangeNotify) {
+      return stats_.Entry("event", "RRScreenChangeNotify");
+    }
+    if (type == randr_event_base_ + RRNotify) {
+      return stats_.Entry("event", "RRNotify");
+    }
+  }
+  return stats_.Entry("event", "Other");
+}
+
+void WindowManager::DispatchEvent(XEvent& e) {
+  switch (e.type) {
+    case CreateNotify:
+      OnCreateNotify(e.xcreatewindow);
+      break;
+    case DestroyNotify:
+      OnDestroyNotify(e.xdestroywindow);
+      break;
+    case ReparentNotify:
+      OnReparentNotify(e.xreparent);
+      break;
+    case MapNotify:
+      OnMapNotify(e.xmap);
+      break;
+    case UnmapNotify:
+      OnUnmapNotify(e.xunmap);
+      break;
+    case ConfigureNotify:
+      OnConfigureNotify(e.xconfigure);
+      break;
+    case MapRequest:
+      OnMapRequest(e.xmaprequest);
+      break;
+    case ConfigureRequest:
+      OnConfigureRequest(e.xconfigurerequest);
+      break;
+    case PropertyNotify:
+      OnPropertyNotify(e.xproperty);
+      break;
+    case ButtonPress:
+      OnButtonPress(e.xbutton);
+      break;
+    case ButtonRelease:
+      OnButtonRelease(e.xbutton);
+      break;
+    case MotionNotify:
+      // Skip any already pending motion events. Recordings already hold the
+      // coalesced motion, and live input must not leak into a replay.
+      while (!replaying_ && XCheckTypedWindowEvent(
+          display_, e.xmotion.window, MotionNotify, &e)) {
+        if (recorder_) {
+          recorder_->RecordEvent(e, true);
+        }
+      }
+      OnMotionNotify(e.xmotion);
+      break;
+    case KeyPress:
+      OnKeyPress(e.xkey);
+      break;
+    case KeyRelease:
+      OnKeyRelease(e.xkey);
+      break;
+    case FocusIn:
+      OnFocusIn(e.xfocus);
+      break;
+    case EnterNotify:
+      OnEnterNotify(e.xcrossing);
+      break;
+    case MappingNotify:
+      OnMappingNotify(e.xmapping);
+      break;
+    case ClientMessage:
+      OnClientMessage(e.xclient);
+      break;
+    default:
+      if (randr_event_base_ >= 0 &&
+          e.type == randr_event_base_ + RRScreenChangeNotify) {
+        OnScreenChangeNotify(e);
+      } else if (randr_event_base_ >= 0 &&
+                 e.type == randr_event_base_ + RRNotify) {
+        // A CRTC was reconfigured, which may move or resize monitors without
+        // changing the screen size.
+        UpdateMonitors();
+      } else {
+        TRACE(DEBUG) << "Ignored event";
+      }
+  }
+}
 
+void WindowManager::Frame(Window w, bool was_created_before_window_manager) {
   // 1. Retrieve attributes of window to frame.
   XWindowAttributes x_window_attrs;
   CHECK(XGetWindowAttributes(display_, w, &x_window_attrs));
@@ -170,142 +626,280 @@ void WindowManager::Frame(Window w, bool was_created_before_window_manager) {
     }
   }
 
-  // 3. Create frame.
-  const Window frame = XCreateSimpleWindow(
+  // 3. Frame it.
+  Frame(
+      w,
+      Rect(
+          x_window_attrs.x, x_window_attrs.y,
+          x_window_attrs.width, x_window_attrs.height),
+      x_window_attrs.map_state == IsViewable,
+      ReadWindowType(w),
+      ReadDeletable(w));
+}
+
+void WindowManager::Frame(
+    Window w, const Rect& geometry, bool mapped, WindowType type,
+    bool deletable) {
+  // 1. Docks are tracked but not framed, so that they keep their place and
+  // stay out of the tiling layout. We shouldn't be framing windows we've
+  // already framed, which Insert() checks.
+  Client& client = *clients_.Insert(w);
+  client.frame_pos = Position<int>(geometry.x, geometry.y);
+  client.frame_size = Size<int>(geometry.width, geometry.height);
+  client.client_size = client.frame_size;
+  client.mapped = mapped;
+  client.type = type;
+  client.deletable = deletable;
+  client.monitor = MonitorAt(
+      geometry.x + geometry.width / 2, geometry.y + geometry.height / 2);
+  client.workspace = current_workspace_;
+  // Watch for changes to the window type and protocols, so that they never
+  // have to be re-read otherwise, and for the client taking the focus.
+  XSelectInput(display_, w, PropertyChangeMask | FocusChangeMask);
+  if (client.type == WindowType::DOCK) {
+    client.client_pos = client.frame_pos;
+    bar_ = w;
+    TRACE(INFO) << "Tracking dock " << w;
+    return;
+  }
+
+  // 2. Create frame, selecting events on it. The frame has no background, so
+  // that the server never clears it when it is resized; the client covers it
+  // entirely, and is the only one to repaint. Its contents, and the client
+  // window, stay anchored to the top left corner.
+  XSetWindowAttributes frame_attrs;
+  frame_attrs.background_pixmap = None;
+  frame_attrs.border_pixel = config_->border_color;
+  frame_attrs.bit_gravity = NorthWestGravity;
+  frame_attrs.win_gravity = NorthWestGravity;
+  frame_attrs.event_mask =
+      SubstructureRedirectMask | SubstructureNotifyMask | EnterWindowMask;
+  const Window frame = XCreateWindow(
       display_,
       root_,
-      x_window_attrs.x,
-      x_window_attrs.y,
-      x_window_attrs.width,
-      x_window_attrs.height,
-      BORDER_WIDTH,
-      BORDER_COLOR,
-      BG_COLOR);
-  // 4. Select events on frame.
-  XSelectInput(
-      display_,
-      frame,
-      SubstructureRedirectMask | SubstructureNotifyMask);
-  // 5. Add client to save set, so that it will be restored and kept alive if we
+      geometry.x,
+      geometry.y,
+      geometry.width,
+      geometry.height,
+      config_->border_width,
+      CopyFromParent,
+      InputOutput,
+      CopyFromParent,
+      CWBackPixmap | CWBorderPixel | CWBitGravity | CWWinGravity | CWEventMask,
+      &frame_attrs);
+  // 3. Add client to save set, so that it will be restored and kept alive if we
   // crash.
   XAddToSaveSet(display_, w);
-  // 6. Reparent client window.
+  // 4. Reparent client window.
   XReparentWindow(
       display_,
       w,
       frame,
       0, 0);  // Offset of client window within frame.
-  // 7. Map frame.
-  XMapWindow(display_, frame);
-  // 8. Save frame handle.
-  clients_[w] = frame;
-  // 9. Grab universal window management actions on client window.
-  //   a. Move windows with alt + left button.
-  XGrabButton(
-      display_,
-      Button1,
-      Mod1Mask,
-      w,
-      false,
-      ButtonPressMask | ButtonReleaseMask | ButtonMotionMask,
-      GrabModeAsync,
-      GrabModeAsync,
-      None,
-      None);
-  //   b. Resize windows with alt + right button.
-  XGrabButton(
-      display_,
-      Button3,
-      Mod1Mask,
-      w,
-      false,
-      ButtonPressMask | ButtonReleaseMask | ButtonMotionMask,
-      GrabModeAsync,
-      GrabModeAsync,
-      None,
-      None);
-  XGrabKey(
-      display_,
-      XKeysymToKeycode(display_, XK_Q),
-      Mod1Mask,
-      w,
-      false,
-      GrabModeAsync,
-      GrabModeAsync);
-  //   d. Switch windows with alt + tab.
-  XGrabKey(
-      display_,
-      XKeysymToKeycode(display_, XK_Return),
-      Mod1Mask,
-      root_,
-      false,
-      GrabModeAsync,
-      GrabModeAsync);
+  // 5. Map frame, unless the client is only about to be mapped, in which case
+  // its first relayout maps the frame once it is in place.
+  if (mapped) {
+    XMapWindow(display_, frame);
+    client.placed = true;
+  }
+  // 6. Save frame handle.
+  client.frame = frame;
+  clients_.IndexFrame(&client);
+  focus_.Add(&client);
+  if (recorder_) {
+    recorder_->RecordFrame(w, frame);
+  }
+  LayoutOf(&client).Insert(w);
+  AddToClientList(w);
+  TRACE(INFO) << "Framed window " << w << " [" << frame << "]";
+}
 
-  XGrabKey(
-      display_,
-      XKeysymToKeycode(display_, XK_Tab),
-      Mod1Mask,
-      w,
-      false,
-      GrabModeAsync,
-      GrabModeAsync);
-  XGrabKey( //Tile windows
-      display_,
-      XKeysymToKeycode(display_, XK_T),
-      Mod1Mask,
-      root_,
-      false,
-      GrabModeAsync,
-      GrabModeAsync);
-  XGrabKey(
-      display_,
-      XKeysymToKeycode(display_, XK_F),
-      Mod1Mask,
-      w,
-      false,
-      GrabModeAsync,
-      GrabModeAsync);
-  XGrabKey(
-      display_,
-      XKeysymToKeycode(display_, XK_Right),
-      Mod1Mask,
-      w,
-      false,
-      GrabModeAsync,
-      GrabModeAsync);
-  XGrabKey(
-      display_,
-      XKeysymToKeycode(display_, XK_Left),
-      Mod1Mask,
-      w,
-      false,
-      GrabModeAsync,
-      GrabModeAsync);
-  XGrabKey(
-      display_,
-      XKeysymToKeycode(display_, XK_D),
-      Mod1Mask,
-      w,
-      false,
-      GrabModeAsync,
-      GrabModeAsync);
-  XGrabKey(
+void WindowManager::AdoptWindows(
+    const Window* windows,
+    unsigned int n,
+    const ::std::unordered_map<Window, SavedFrame>& saved_frames) {
+  // Xlib would wait for the replies of each window before asking about the
+  // next, all while the server is grabbed. With XCB all requests go out at
+  // once, and the whole batch costs a single round trip.
+  xcb_connection_t* connection = XGetXCBConnection(display_);
+  // 1. Send requests for everything Frame() needs to know. For frames of a
+  // previous instance, also check that they still hold the saved client.
+  vector<xcb_get_window_attributes_cookie_t> attrs_cookies(n);
+  vector<xcb_get_geometry_cookie_t> geometry_cookies(n);
+  vector<xcb_get_property_cookie_t> type_cookies(n);
+  vector<xcb_get_property_cookie_t> protocols_cookies(n);
+  vector<xcb_query_tree_cookie_t> tree_cookies(n);
+  vector<xcb_get_geometry_cookie_t> client_geometry_cookies(n);
+  vector<const SavedFrame*> saved(n, nullptr);
+  const auto get_protocols = [&](Window w) {
+    return xcb_get_property(
+        connection, false, w, atoms_[WM_PROTOCOLS], XCB_ATOM_ATOM, 0, ~0U);
+  };
+  for (unsigned int i = 0; i < n; ++i) {
+    attrs_cookies[i] = xcb_get_window_attributes(connection, windows[i]);
+    geometry_cookies[i] = xcb_get_geometry(connection, windows[i]);
+    auto j = saved_frames.find(windows[i]);
+    if (j != saved_frames.end()) {
+      saved[i] = &j->second;
+      tree_cookies[i] = xcb_query_tree(connection, windows[i]);
+      client_geometry_cookies[i] =
+          xcb_get_geometry(connection, saved[i]->window);
+      protocols_cookies[i] = get_protocols(saved[i]->window);
+      continue;
+    }
+    protocols_cookies[i] = get_protocols(windows[i]);
+    type_cookies[i] = xcb_get_property(
+        connection,
+        false,
+        windows[i],
+        atoms_[NET_WM_WINDOW_TYPE],
+        XCB_ATOM_ATOM,
+        0, ~0U);
+  }
+  // 2. Collect replies. Saved frames are taken over as they are, and other
+  // windows are framed if they are visible and don't set override_redirect.
+  vector<const SavedFrame*> adopted;
+  for (unsigned int i = 0; i < n; ++i) {
+    xcb_get_window_attributes_reply_t* attrs = xcb_get_window_attributes_reply(
+        connection, attrs_cookies[i], nullptr);
+    xcb_get_geometry_reply_t* geometry = xcb_get_geometry_reply(
+        connection, geometry_cookies[i], nullptr);
+    xcb_get_property_reply_t* protocols = xcb_get_property_reply(
+        connection, protocols_cookies[i], nullptr);
+    const vector<Atom> protocol_atoms = AtomsOf(protocols);
+    const bool deletable =
+        HasDeleteProtocol(protocol_atoms.data(), protocol_atoms.size());
+    free(protocols);
+    if (saved[i] != nullptr) {
+      xcb_query_tree_reply_t* tree =
+          xcb_query_tree_reply(connection, tree_cookies[i], nullptr);
+      xcb_get_geometry_reply_t* client_geometry = xcb_get_geometry_reply(
+          connection, client_geometry_cookies[i], nullptr);
+      const bool intact =
+          attrs != nullptr && geometry != nullptr && tree != nullptr &&
+          client_geometry != nullptr &&
+          xcb_query_tree_children_length(tree) == 1 &&
+          xcb_query_tree_children(tree)[0] == saved[i]->window;
+      if (intact) {
+        AdoptFrame(
+            windows[i],
+            *saved[i],
+            Rect(geometry->x, geometry->y, geometry->width, geometry->height),
+            Rect(
+                client_geometry->x, client_geometry->y,
+                client_geometry->width, client_geometry->height),
+            deletable);
+        adopted.push_back(saved[i]);
+      } else {
+        // The client went away while we were restarting, leaving an empty
+        // frame behind that nobody else will clean up.
+        XDestroyWindow(display_, windows[i]);
+      }
+      free(tree);
+      free(client_geometry);
+    } else {
+      xcb_get_property_reply_t* type = xcb_get_property_reply(
+          connection, type_cookies[i], nullptr);
+      if (attrs != nullptr && geometry != nullptr &&
+          !attrs->override_redirect &&
+          attrs->map_state == XCB_MAP_STATE_VIEWABLE) {
+        const vector<Atom> types = AtomsOf(type);
+        Frame(
+            windows[i],
+            Rect(geometry->x, geometry->y, geometry->width, geometry->height),
+            true,
+            ClassifyWindowType(types.data(), types.size()),
+            deletable);
+      }
+      free(type);
+    }
+    free(attrs);
+    free(geometry);
+  }
+  // 3. Restore the saved tile order and sizes ahead of any newly framed
+  // windows, so that the layouts come back exactly as they were.
+  ::std::sort(
+      adopted.begin(), adopted.end(),
+      [](const SavedFrame* a, const SavedFrame* b) { return a->tile < b->tile; });
+  vector<Layout*> layouts;
+  for (Monitor& monitor : monitors_) {
+    for (Layout& layout : monitor.layouts) {
+      layouts.push_back(&layout);
+    }
+  }
+  vector<vector<::std::pair<Window, double>>> tiles(layouts.size());
+  for (size_t i = 0; i < layouts.size(); ++i) {
+    tiles[i] = layouts[i]->Tiles();
+    for (const auto& tile : tiles[i]) {
+      layouts[i]->Remove(tile.first);
+    }
+  }
+  for (const SavedFrame* frame : adopted) {
+    const Client* client = FindClient(frame->window);
+    LayoutOf(client).Insert(frame->window, frame->weight);
+  }
+  for (size_t i = 0; i < layouts.size(); ++i) {
+    for (const auto& tile : tiles[i]) {
+      layouts[i]->Insert(tile.first, tile.second);
+    }
+  }
+}
+
+void WindowManager::AdoptFrame(
+    Window frame, const SavedFrame& saved, const Rect& frame_geometry,
+    const Rect& client_geometry, bool deletable) {
+  const Window w = saved.window;
+
+  // 1. Record the client as Frame() would have.
+  Client& client = *clients_.Insert(w);
+  client.frame = frame;
+  client.frame_pos = Position<int>(frame_geometry.x, frame_geometry.y);
+  client.frame_size = Size<int>(frame_geometry.width, frame_geometry.height);
+  client.client_pos = Position<int>(client_geometry.x, client_geometry.y);
+  client.client_size = Size<int>(client_geometry.width, client_geometry.height);
+  client.mapped = true;
+  client.placed = true;
+  client.type = WindowType::NORMAL;
+  client.deletable = deletable;
+  client.monitor = ::std::min(saved.monitor, monitors_.size() - 1);
+  client.workspace = ::std::min(saved.workspace, WORKSPACE_COUNT - 1);
+  clients_.IndexFrame(&client);
+  focus_.Add(&client);
+  AddToClientList(w);
+  // 2. Event selections die with the connection that made them, so make our
+  // own. The windows themselves stay exactly where they are.
+  XSelectInput(display_, w, PropertyChangeMask | FocusChangeMask);
+  XSelectInput(
       display_,
-      XKeysymToKeycode(display_, XK_A),
-      Mod1Mask,
-      w,
-      false,
-      GrabModeAsync,
-      GrabModeAsync);
-  LOG(INFO) << "Framed window " << w << " [" << frame << "]";
+      frame,
+      SubstructureRedirectMask | SubstructureNotifyMask | EnterWindowMask);
+  // 3. SaveState() took the client out of the save set of the previous
+  // instance.
+  XAddToSaveSet(display_, w);
+  // 4. Frames of hidden workspaces were left unmapped.
+  if (client.workspace == current_workspace_) {
+    XMapWindow(display_, frame);
+  } else {
+    XUnmapWindow(display_, frame);
+  }
+  TRACE(INFO) << "Adopted window " << w << " [" << frame << "]";
 }
 
 void WindowManager::Unframe(Window w) {
-  CHECK(clients_.count(w));
+  Client& client = *CHECK_NOTNULL(clients_.Find(w));
+
+  // Docks were never framed, so there is nothing to reverse.
+  const Window frame = client.frame;
+  if (frame == None) {
+    clients_.Erase(&client);
+    if (bar_ == w) {
+      bar_ = None;
+    }
+    TRACE(INFO) << "Stopped tracking dock " << w;
+    return;
+  }
 
   // We reverse the steps taken in Frame().
-  const Window frame = clients_[w];
   // 1. Unmap frame.
   XUnmapWindow(display_, frame);
   // 2. Reparent client window.
@@ -318,26 +912,72 @@ void WindowManager::Unframe(Window w) {
   XRemoveFromSaveSet(display_, w);
   // 4. Destroy frame.
   XDestroyWindow(display_, frame);
-  // 5. Drop reference to frame handle.
-  clients_.erase(w);
+  // 5. Drop reference to frame handle, and let the remaining windows close the
+  // gap.
+  LayoutOf(&client).Remove(w);
+  if (client.workspace == current_workspace_) {
+    DeferRelayout(client.monitor);
+  }
+  RemoveFromClientList(w);
+  const bool was_focused = focus_.focused() == &client;
+  focus_.Remove(&client);
+  // A client that withdraws its window after being asked to close has
+  // closed, and its window ID may be reused.
+  auto kill_timer = kill_timers_.find(w);
+  if (kill_timer != kill_timers_.end()) {
+    event_loop_.CancelTimer(kill_timer->second);
+    kill_timers_.erase(kill_timer);
+  }
+  clients_.Erase(&client);
 
-  LOG(INFO) << "Unframed window " << w << " [" << frame << "]";
+  // 6. Pass the focus on, rather than leaving it to revert to the root window.
+  if (was_focused) {
+    FocusMostRecent();
+  }
+
+  TRACE(INFO) << "Unframed window " << w << " [" << frame << "]";
 }
 
 void WindowManager::OnCreateNotify(const XCreateWindowEvent& e) {}
 
-void WindowManager::OnDestroyNotify(const XDestroyWindowEvent& e) {}
+void WindowManager::OnDestroyNotify(const XDestroyWindowEvent& e) {
+  // Docks are never unframed through UnmapNotify, so drop their records here,
+  // and give their space back.
+  Client* client = FindClient(e.window);
+  if (client != nullptr && client->type == WindowType::DOCK) {
+    Unframe(e.window);
+    RequestRelayout();
+  }
+}
 
 void WindowManager::OnReparentNotify(const XReparentEvent& e) {}
 
-void WindowManager::OnMapNotify(const XMapEvent& e) {}
+void WindowManager::OnMapNotify(const XMapEvent& e) {
+  Client* client = FindClient(e.window);
+  if (client == nullptr || client->mapped) {
+    return;
+  }
+  client->mapped = true;
+  // A dock takes space from the tiles once it is shown.
+  if (client->type == WindowType::DOCK) {
+    RequestRelayout();
+  }
+}
 
 void WindowManager::OnUnmapNotify(const XUnmapEvent& e) {
   // If the window is a client window we manage, unframe it upon UnmapNotify. We
   // need the check because we will receive an UnmapNotify event for a frame
   // window we just destroyed ourselves.
-  if (!clients_.count(e.window)) {
-    LOG(INFO) << "Ignore UnmapNotify for non-client window " << e.window;
+  Client* client = FindClient(e.window);
+  if (client == nullptr) {
+    TRACE(DEBUG) << "Ignore UnmapNotify for non-client window " << e.window;
+    return;
+  }
+
+  // Docks stay tracked while unmapped; they are dropped on DestroyNotify.
+  if (client->type == WindowType::DOCK) {
+    client->mapped = false;
+    RequestRelayout();
     return;
   }
 
@@ -351,93 +991,295 @@ void WindowManager::OnUnmapNotify(const XUnmapEvent& e) {
   // UnmapNotify event triggered by reparenting a pre-existing window will have
   // this attribute set to the root window.
   if (e.event == root_) {
-    LOG(INFO) << "Ignore UnmapNotify for reparented pre-existing window "
+    TRACE(DEBUG) << "Ignore UnmapNotify for reparented pre-existing window "
               << e.window;
     return;
   }
 
+  // Likewise, ignore the UnmapNotify from reparenting a window out of a frame
+  // we have since replaced, such as when its window type changed.
+  if (e.event != client->frame) {
+    TRACE(DEBUG) << "Ignore UnmapNotify from stale frame " << e.event;
+    return;
+  }
+
   Unframe(e.window);
 }
 
-void WindowManager::OnConfigureNotify(const XConfigureEvent& e) {}
+void WindowManager::OnConfigureNotify(const XConfigureEvent& e) {
+  // Frames and docks are children of the root window, and clients are children
+  // of their frames, so the window and event fields tell us which part of a
+  // client record the new geometry belongs to.
+  const Position<int> pos(e.x, e.y);
+  const Size<int> size(e.width, e.height);
+  Client* client = FindClientByFrame(e.window);
+  if (client != nullptr) {
+    client->frame_pos = pos;
+    client->frame_size = size;
+    return;
+  }
+  client = FindClient(e.window);
+  if (client == nullptr) {
+    return;
+  }
+  if (client->type == WindowType::DOCK) {
+    // Tiles make room for the dock where it now is.
+    if (client->frame_pos.x != pos.x || client->frame_pos.y != pos.y ||
+        client->frame_size.width != size.width ||
+        client->frame_size.height != size.height) {
+      RequestRelayout();
+    }
+    client->frame_pos = pos;
+    client->frame_size = size;
+    client->client_pos = pos;
+    client->client_size = size;
+  } else if (e.event == client->frame) {
+    client->client_pos = pos;
+    client->client_size = size;
+  }
+}
 
 void WindowManager::OnMapRequest(const XMapRequestEvent& e) {
-  // 1. Frame or re-frame window.
+  // Docks stay tracked while unmapped, so one mapping itself again is already
+  // known, and only takes its space back.
+  Client* dock = FindClient(e.window);
+  if (dock != nullptr && dock->type == WindowType::DOCK) {
+    XMapWindow(display_, e.window);
+    dock->mapped = true;
+    RequestRelayout();
+    return;
+  }
+  // 1. Frame or re-frame window. The frame stays unmapped until the window
+  // is tiled.
   Frame(e.window, false);
   // 2. Actually map window.
   XMapWindow(display_, e.window);
-  Tuple CursorPosition = getCursor(display_);
 
-  int screenWidth = GetScreenWidth(display_);
-  int screenHeight = GetScreenHeight(display_);
-  
-  Window returned_root, returned_parent;
-  Window* top_level_windows;
-  unsigned int num_top_level_windows;
-  
-  if (isBar(e.window) == 1) {
-    Unframe(e.window);
+  // 3. Tile it on the monitor under the cursor, along with any other windows
+  // mapped right after it. Docks place themselves, and take their space.
+  Client* client = FindClient(e.window);
+  if (client == nullptr) {
+    return;
+  }
+  if (client->type == WindowType::DOCK) {
+    RequestRelayout();
+    return;
+  }
+  const Position<int> pointer_pos = QueryPointer();
+  AssignMonitor(client, MonitorAt(pointer_pos.x, pointer_pos.y));
+  // Monocle layouts only arrange the current window, so a new one is shown by
+  // making it current.
+  Layout& layout = LayoutOf(client);
+  if (layout.mode() == LayoutMode::MONOCLE) {
+    layout.SetCurrent(e.window);
   }
+  DeferRelayout(client->monitor);
+}
+
+void WindowManager::RequestRelayout(size_t monitor) {
+  monitors_[monitor].relayout_pending = true;
+  relayout_pending_ = true;
+}
+
+void WindowManager::RequestRelayout() {
+  for (size_t i = 0; i < monitors_.size(); ++i) {
+    RequestRelayout(i);
+  }
+}
+
+void WindowManager::DeferRelayout(size_t monitor) {
+  // 1. Without a delay, windows are tiled at the end of the batch like any
+  // other change.
+  monitors_[monitor].relayout_pending = true;
+  const int delay_ms = config_->relayout_delay;
+  if (delay_ms == 0) {
+    relayout_pending_ = true;
+    return;
+  }
+  // 2. Otherwise restart the wait, unless that would exceed the longest wait.
+  // Monitors whose relayout_pending is set are laid out by whichever pass
+  // comes first, so an earlier pass for some other reason ends the wait.
+  const ::std::chrono::steady_clock::time_point now =
+      ::std::chrono::steady_clock::now();
+  if (relayout_timer_ == -1) {
+    relayout_deferred_since_ = now;
+  } else if (now - relayout_deferred_since_ +
+                 ::std::chrono::milliseconds(delay_ms) >
+             ::std::chrono::milliseconds(MAX_RELAYOUT_DELAY_MS)) {
+    return;
+  } else {
+    event_loop_.CancelTimer(relayout_timer_);
+  }
+  relayout_timer_ = event_loop_.AddTimer(
+      delay_ms, false, [this] { OnRelayoutTimer(); });
+}
+
+void WindowManager::OnRelayoutTimer() {
+  if (recorder_) {
+    recorder_->RecordRelayoutTick();
+  }
+  // The timer has fired, and its ID may be handed out again to another one,
+  // which must not be cancelled in its place.
+  relayout_timer_ = -1;
+  // The pass itself runs as part of the batch the timer fired in.
+  relayout_pending_ = true;
+}
+
+void WindowManager::Relayout() {
+  Stats::Scope scope(&stats_, stats_.Entry("handler", "Relayout"));
+  // Every pending monitor is laid out now, deferred or not.
+  event_loop_.CancelTimer(relayout_timer_);
+  relayout_timer_ = -1;
+  relayout_pending_ = false;
+  for (size_t i = 0; i < monitors_.size(); ++i) {
+    Monitor& monitor = monitors_[i];
+    if (!monitor.relayout_pending) {
+      continue;
+    }
+    monitor.relayout_pending = false;
+    // 1. Compute the target rectangles of the monitor up front, leaving out
+    // tiles that are still where the layout last put them.
+    // Tiles are inset by half the gap, and the area by the other half, so
+    // that gaps between tiles and along the edges are the same.
+    Layout& layout = monitor.layouts[current_workspace_];
+    const int gap = config_->gap;
+    const auto tiles = layout.Rearrange(TilingArea(i).Inset(gap - gap / 2));
+    // 2. Reconfigure only the windows that aren't in place yet, and show new
+    // windows now that they are. Frame borders are drawn outside the frame's
+    // size, so frames are made smaller by them to stay within their tiles.
+    bool current_placed = false;
+    const int border = config_->border_width;
+    for (const auto& tile : tiles) {
+      Client* client = FindClient(tile.first);
+      const Rect r = tile.second.Inset(gap / 2);
+      ConfigureFrame(
+          client,
+          Rect(
+              r.x, r.y,
+              max(r.width - 2 * border, 1), max(r.height - 2 * border, 1)));
+      if (!client->placed) {
+        XMapWindow(display_, client->frame);
+        client->placed = true;
+        current_placed = current_placed || tile.first == layout.current();
+      }
+    }
+    // 3. Hidden monocle windows are left as they are, below the current one.
+    // New windows that didn't end up current are mapped there as well, so
+    // that they can be cycled to. A new current window takes the focus.
+    if (layout.mode() == LayoutMode::MONOCLE && layout.current() != None) {
+      for (const auto& tile : layout.Tiles()) {
+        Client* client = FindClient(tile.first);
+        if (!client->placed) {
+          XMapWindow(display_, client->frame);
+          client->placed = true;
+        }
+      }
+      Client* current = FindClient(layout.current());
+      XRaiseWindow(display_, current->frame);
+      if (current_placed) {
+        SetFocus(current, false);
+      }
+    }
+  }
+}
+
+Rect WindowManager::TilingArea(size_t monitor) {
+  // The bar only takes space from the monitor it is on.
+  Rect area = monitors_[monitor].geometry;
+  const Client* bar = FindClient(bar_);
+  if (bar != nullptr &&
+      MonitorAt(
+          bar->frame_pos.x + bar->frame_size.width / 2,
+          bar->frame_pos.y + bar->frame_size.height / 2) == monitor) {
+    const int bar_height = getBarHeight();
+    area.y += bar_height;
+    area.height -= bar_height;
+  }
+  return area;
+}
+
+size_t WindowManager::MonitorAt(int x, int y) const {
+  for (size_t i = 0; i < monitors_.size(); ++i) {
+    const Rect& r = monitors_[i].geometry;
+    if (x >= r.x && x < r.x + r.width && y >= r.y && y < r.y + r.height) {
+      return i;
+    }
+  }
+  return 0;
+}
+
+void WindowManager::AssignMonitor(Client* c, size_t monitor) {
+  if (c->monitor == monitor) {
+    return;
+  }
+  LayoutOf(c).Remove(c->window);
+  c->monitor = monitor;
+  LayoutOf(c).Insert(c->window);
+}
+
+Layout& WindowManager::LayoutOf(const Client* c) {
+  return monitors_[c->monitor].layouts[c->workspace];
+}
 
-  const Window frame = clients_[e.window]; //get frame of mapped window to move it
-  Tuple crsr = getCursor(display_);
-  XWindowAttributes attrs;
-  XGetWindowAttributes(display_, frame, &attrs);
-  XMoveWindow(display_, frame, crsr.x - (attrs.width / 2), crsr.y - (attrs.height / 2));
-}
-
-void WindowManager::iterateWindows() {
-unsigned int n;
-      	Window *wins, *w, dw;
-      	XWindowAttributes wa;
-      
-      	if (!XQueryTree(display_, root_, &dw, &dw, &wins, &n) || !n)
-      		return;
-
-int wcount;
-wcount = 0; 
-  for (w = &wins[n-1]; w >= &wins[0]; w--) {
-      		if (XGetWindowAttributes(display_, *w, &wa)
-      		&& !wa.override_redirect && wa.map_state == IsViewable) {
-            if (isBar(*w) == 0) {
-              wcount = wcount + 1;
-
-            }
-            else if (isBar(*w) == 1) {
-              bar_ = *w;
-            }
-      	}
-  }
-  int noi = 0; //number of iteration
-  for (w = &wins[n-1]; w >= &wins[0]; w--) {
-      		if (
-              XGetWindowAttributes(display_, *w, &wa) // get wnindow attributes of window w
-              && !wa.override_redirect && wa.map_state == IsViewable
-          ) {
-            if (isBar(*w) == 0) {
-            XResizeWindow(display_, *w, GetScreenWidth(display_) / (wcount), (GetScreenHeight(display_) - getBarHeight()));
-            XMoveWindow(display_, *w, (GetScreenWidth(display_) / wcount) * noi, getBarHeight());
-
-            unsigned int an;
-      	    Window *awins, *aw, adw;
-      	    XWindowAttributes awa;
-      
-      	    if (!XQueryTree(display_, *w, &adw, &adw, &awins, &an) || !an)
-      		    return;
-                for (aw = &awins[n-1]; aw >= &awins[0]; aw--) {
-      		        if (XGetWindowAttributes(display_, *aw, &awa)
-      		        && !awa.override_redirect && awa.map_state == IsViewable) {
-                        XResizeWindow(display_, *aw, GetScreenWidth(display_) / (wcount), (GetScreenHeight(display_) - getBarHeight()));
-      	          }
-                }
-            noi++; 
-            }
-            
-      	}
+void WindowManager::OnPropertyNotify(const XPropertyEvent& e) {
+  Client* client = FindClient(e.window);
+  if (client == nullptr) {
+    return;
+  }
+  // Protocols are only ever fetched here and in Frame().
+  if (e.atom == atoms_[WM_PROTOCOLS]) {
+    client->deletable = ReadDeletable(e.window);
+    return;
+  }
+  if (e.atom != atoms_[NET_WM_WINDOW_TYPE]) {
+    return;
+  }
+  // 1. Re-read the window type; it is only ever fetched here and in Frame().
+  const WindowType type = ReadWindowType(e.window);
+  if (type == client->type) {
+    return;
+  }
+  // 2. A window that changes between dock and normal needs to be framed or
+  // unframed, which is done by managing it afresh.
+  TRACE(INFO) << "Window type of " << e.window << " changed, re-managing it";
+  const Window w = e.window;
+  const size_t monitor = client->monitor;
+  Unframe(w);
+  Frame(w, true);
+  // Docks change the tiling area, and windows leave or join a layout.
+  RequestRelayout(monitor);
+  client = FindClient(w);
+  if (client != nullptr && client->type == WindowType::DOCK) {
+    RequestRelayout();
+  } else if (client != nullptr) {
+    RequestRelayout(client->monitor);
   }
 }
 
 void WindowManager::OnConfigureRequest(const XConfigureRequestEvent& e) {
+  // 1. Framed clients are tiled, and keep the geometry of their tile. They are
+  // told where they are instead, as if the request had been carried out.
+  Client* client = FindClient(e.window);
+  if (client != nullptr && client->frame != None) {
+    XEvent notify;
+    memset(&notify, 0, sizeof(notify));
+    notify.xconfigure.type = ConfigureNotify;
+    notify.xconfigure.event = e.window;
+    notify.xconfigure.window = e.window;
+    // Synthetic events are in root coordinates, and the client sits at the
+    // top left corner of its frame, inside the frame's border.
+    notify.xconfigure.x = client->frame_pos.x + config_->border_width;
+    notify.xconfigure.y = client->frame_pos.y + config_->border_width;
+    notify.xconfigure.width = client->client_size.width;
+    notify.xconfigure.height = client->client_size.height;
+    notify.xconfigure.border_width = 0;
+    notify.xconfigure.above = None;
+    notify.xconfigure.override_redirect = false;
+    XSendEvent(display_, e.window, false, StructureNotifyMask, &notify);
+    TRACE(DEBUG) << "Kept " << e.window << " at " << client->client_size;
+    return;
+  }
+  // 2. Unmanaged windows and docks place themselves.
   XWindowChanges changes;
   changes.x = e.x;
   changes.y = e.y;
@@ -446,274 +1288,1117 @@ void WindowManager::OnConfigureRequest(const XConfigureRequestEvent& e) {
   changes.border_width = e.border_width;
   changes.sibling = e.above;
   changes.stack_mode = e.detail;
-  if (clients_.count(e.window)) {
-    const Window frame = clients_[e.window];
-    XConfigureWindow(display_, frame, e.value_mask, &changes);
-    LOG(INFO) << "Resize [" << frame << "] to " << Size<int>(e.width, e.height);
-  }
   XConfigureWindow(display_, e.window, e.value_mask, &changes);
-  LOG(INFO) << "Resize " << e.window << " to " << Size<int>(e.width, e.height);
+  TRACE(DEBUG) << "Resize " << e.window << " to " << Size<int>(e.width, e.height);
 }
 
 void WindowManager::OnButtonPress(const XButtonEvent& e) {
-  if (isBar(e.window)) {
+  // Buttons are grabbed on the root window, so the event's subwindow is the
+  // frame that was clicked.
+  Client* client = FindClientByFrame(e.subwindow);
+  if (client == nullptr || drag_window_ != None) {
     return;
   }
-  CHECK(clients_.count(e.window));
-  const Window frame = clients_[e.window];
+  const Window frame = client->frame;
+  drag_window_ = client->window;
+  drag_button_ = e.button;
+  // The window is about to leave its tile, and the next relayout must put it
+  // back.
+  LayoutOf(client).Invalidate(client->window);
+  outline_resize_ = config_->outline_resize;
 
   // 1. Save initial cursor position.
   drag_start_pos_ = Position<int>(e.x_root, e.y_root);
+  drag_pos_ = drag_start_pos_;
 
   // 2. Save initial window info.
-  Window returned_root;
-  int x, y;
-  unsigned width, height, border_width, depth;
-  CHECK(XGetGeometry(
-      display_,
-      frame,
-      &returned_root,
-      &x, &y,
-      &width, &height,
-      &border_width,
-      &depth));
-  drag_start_frame_pos_ = Position<int>(x, y);
-  drag_start_frame_size_ = Size<int>(width, height);
+  drag_start_frame_pos_ = client->frame_pos;
+  drag_start_frame_size_ = client->frame_size;
 
   // 3. Raise clicked window to top.
   XRaiseWindow(display_, frame);
 }
 
-void WindowManager::OnButtonRelease(const XButtonEvent& e) {}
-
-void WindowManager::OnMotionNotify(const XMotionEvent& e) {
-  //CHECK(clients_.count(e.window));
-  if (isBar(e.window)) {
+void WindowManager::OnButtonRelease(const XButtonEvent& e) {
+  if (drag_window_ == None || e.button != drag_button_) {
     return;
   }
-  const Window frame = clients_[e.window];
-  const Position<int> drag_pos(e.x_root, e.y_root);
-  const Vector2D<int> delta = drag_pos - drag_start_pos_;
+  // 1. Catch up with the pointer.
+  drag_pos_ = Position<int>(e.x_root, e.y_root);
+  ApplyDrag();
+  event_loop_.CancelTimer(drag_timer_);
+  drag_timer_ = -1;
+  // 2. An outline resize only tells the client about its new size now.
+  if (outline_visible_) {
+    const Rect r = outline_rect_;
+    DrawOutline(r);
+    outline_visible_ = false;
+    XUngrabServer(display_);
+    Client* client = FindClient(drag_window_);
+    if (client != nullptr) {
+      ConfigureFrame(client, r);
+    }
+  }
+  // 3. A window moved onto another monitor is tiled there from now on, and
+  // the monitor it left closes the gap.
+  Client* client = FindClient(drag_window_);
+  if (client != nullptr && drag_button_ == Button1) {
+    const size_t old_monitor = client->monitor;
+    AssignMonitor(
+        client,
+        MonitorAt(
+            client->frame_pos.x + client->frame_size.width / 2,
+            client->frame_pos.y + client->frame_size.height / 2));
+    if (client->monitor != old_monitor) {
+      RequestRelayout(old_monitor);
+      RequestRelayout(client->monitor);
+    }
+  }
+  drag_window_ = None;
+}
 
-  if (e.state & Button1Mask ) {
-    // alt + left button: Move window.
-    const Position<int> dest_frame_pos = drag_start_frame_pos_ + delta;
-    std::cout << "\n\n";   
-    std::cout << dest_frame_pos.x;
-    if (isBar(frame)) {
+void WindowManager::OnMotionNotify(const XMotionEvent& e) {
+  if (drag_window_ == None) {
     return;
   }
-    XMoveWindow(
+  // Only record where the pointer went. The drag is applied at most once per
+  // display refresh by the drag timer, however fast the mouse reports motion.
+  drag_pos_ = Position<int>(e.x_root, e.y_root);
+  drag_pending_ = true;
+  if (drag_timer_ == -1) {
+    ApplyDrag();
+    drag_timer_ = event_loop_.AddTimer(
+        drag_interval_ms_, true, [this] { OnDragTimer(); });
+  }
+}
+
+void WindowManager::OnDragTimer() {
+  if (recorder_) {
+    recorder_->RecordDragTick();
+  }
+  // Stop ticking once the pointer rests, so an idle drag costs nothing.
+  if (!drag_pending_) {
+    event_loop_.CancelTimer(drag_timer_);
+    drag_timer_ = -1;
+    return;
+  }
+  ApplyDrag();
+}
+
+void WindowManager::ApplyDrag() {
+  Stats::Scope scope(&stats_, stats_.Entry("handler", "ApplyDrag"));
+  drag_pending_ = false;
+  // The pointer may have left the window being dragged, so follow the one the
+  // drag started in rather than the event's subwindow.
+  Client* client = FindClient(drag_window_);
+  if (client == nullptr) {
+    return;
+  }
+  const Window frame = client->frame;
+  const Vector2D<int> delta = drag_pos_ - drag_start_pos_;
+
+  if (drag_button_ == Button1) {
+    // alt + left button: Move window.
+    const Position<int> dest_frame_pos = drag_start_frame_pos_ + delta;
+    if (dest_frame_pos.x == client->frame_pos.x &&
+        dest_frame_pos.y == client->frame_pos.y) {
+      return;
+    }
+    XMoveWindow(
         display_,
         frame,
         dest_frame_pos.x, dest_frame_pos.y);
-  } else if (e.state & Button3Mask) {
+    client->frame_pos = dest_frame_pos;
+  } else if (drag_button_ == Button3) {
     // alt + right button: Resize window.
     // Window dimensions cannot be negative.
     const Vector2D<int> size_delta(
-        max(delta.x, -drag_start_frame_size_.width),
-        max(delta.y, -drag_start_frame_size_.height));
+        max(delta.x, -drag_start_frame_size_.width + 1),
+        max(delta.y, -drag_start_frame_size_.height + 1));
     const Size<int> dest_frame_size = drag_start_frame_size_ + size_delta;
-    // 1. Resize frame.
-  if (isBar(frame) == 1) {
-    printf("\n\n\n ALERT\n\n\n");
-    return;
+    if (outline_resize_) {
+      // Only move the outline; the client is resized on button release.
+      const Rect r(
+          client->frame_pos.x, client->frame_pos.y,
+          dest_frame_size.width, dest_frame_size.height);
+      if (!outline_visible_) {
+        // Nothing may draw under the outline while it is shown, or erasing it
+        // would leave garbage behind.
+        XGrabServer(display_);
+        outline_visible_ = true;
+      } else if (r == outline_rect_) {
+        return;
+      } else {
+        DrawOutline(outline_rect_);
+      }
+      DrawOutline(r);
+      outline_rect_ = r;
+      return;
+    }
+    ConfigureFrame(
+        client,
+        Rect(
+            client->frame_pos.x, client->frame_pos.y,
+            dest_frame_size.width, dest_frame_size.height));
   }
-    XResizeWindow(
-        display_,
-        frame,
-        dest_frame_size.width, dest_frame_size.height);
-    // 2. Resize client window.
-    XResizeWindow(
+}
+
+void WindowManager::DrawOutline(const Rect& r) {
+  if (outline_gc_ == nullptr) {
+    XGCValues values;
+    values.function = GXxor;
+    values.subwindow_mode = IncludeInferiors;
+    values.line_width = config_->border_width;
+    values.foreground =
+        WhitePixel(display_, DefaultScreen(display_)) ^
+        BlackPixel(display_, DefaultScreen(display_));
+    outline_gc_ = XCreateGC(
         display_,
-        e.window,
-        dest_frame_size.width, dest_frame_size.height);
+        root_,
+        GCFunction | GCSubwindowMode | GCLineWidth | GCForeground,
+        &values);
+  }
+  // XOR drawing, so drawing the same rectangle again erases it.
+  XDrawRectangle(display_, root_, outline_gc_, r.x, r.y, r.width, r.height);
+}
+
+void WindowManager::UpdateDragInterval() {
+  // Apply drags once per refresh of the display, or at 60Hz if unknown.
+  short rate = 0;
+  if (randr_event_base_ >= 0) {
+    XRRScreenConfiguration* config = XRRGetScreenInfo(display_, root_);
+    if (config != nullptr) {
+      rate = XRRConfigCurrentRate(config);
+      XRRFreeScreenConfigInfo(config);
+    }
   }
+  drag_interval_ms_ = rate > 0 ? max(1000 / rate, 1) : 16;
 }
 
 void WindowManager::OnKeyPress(const XKeyEvent& e) {
-  if ((e.state & Mod1Mask) &&
-      (e.keycode == XKeysymToKeycode(display_, XK_Q))) {
-     
-     LOG(INFO) << "Killing window " << e.window;
-     XKillClient(display_, e.window);
-     Window returned_root, returned_parent;
-     Window* top_level_windows;
-     unsigned int num_top_level_windows;
-    printf("\nKilled window\n");
-
-    }
- 
-  else if ((e.state & Mod1Mask) &&
-      (e.keycode == XKeysymToKeycode(display_, XK_Right))) {
-      Window returned_root, returned_parent;
-      Window* top_level_windows;
-      unsigned int num_top_level_windows;	
-      CHECK(XQueryTree(
-      display_,
-      root_,
-      &returned_root,
-      &returned_parent,
-      &top_level_windows,
-      &num_top_level_windows));
-      XWindowAttributes wattrs;
-      XGetWindowAttributes(display_, clients_[e.window], &wattrs);
-      
-      for (int i = 0; i < num_top_level_windows; i++) {
-        XWindowAttributes nwattrs;
-        XGetWindowAttributes(display_, top_level_windows[i], &nwattrs);
-        if (nwattrs.x == wattrs.x + wattrs.width && nwattrs.width > 100) {
-          printf("Width: \n \n --\n%d\n", nwattrs.width);
-          XMoveWindow(display_, top_level_windows[i], nwattrs.x + 100, nwattrs.y);
-          printf("\nHere\n");
-          XResizeWindow(display_, top_level_windows[i], nwattrs.width - 100, nwattrs.height);
- 	        XResizeWindow(display_, clients_[e.window], wattrs.width + 100, wattrs.height);
-     	    XResizeWindow(display_, e.window, wattrs.width + 100, wattrs.height);
-       	  XRaiseWindow(display_, clients_[e.window]);
-        }
+  auto i = key_table_.find(KeyTableIndex(e.keycode, e.state));
+  // The keyboard is grabbed while cycling, so every key comes here. Any key
+  // other than the one cycling ends the cycle, except for modifiers, which
+  // repeat while held.
+  if (focus_.cycling() &&
+      (i == key_table_.end() ||
+       i->second.action != &WindowManager::FocusNextWindow)) {
+    XKeyEvent key = e;
+    if (!IsModifierKey(XLookupKeysym(&key, 0))) {
+      EndFocusCycle();
+    }
+  }
+  if (i == key_table_.end()) {
+    return;
+  }
+  // Keys are grabbed on the root window, so the event's subwindow is the frame
+  // under the pointer, which is what the binding acts on.
+  const ResolvedKeyBinding& binding = i->second;
+  const Client* client = FindClientByFrame(e.subwindow);
+  if (binding.needs_client && client == nullptr) {
+    return;
+  }
+  Stats::Scope scope(&stats_, binding.stats);
+  key_press_state_ = e.state;
+  (this->*binding.action)(
+      client == nullptr ? None : client->window, binding.argument);
+  key_press_state_ = 0;
+}
+
+void WindowManager::OnMappingNotify(const XMappingEvent& e) {
+  XEvent event;
+  event.xmapping = e;
+  XRefreshKeyboardMapping(&event.xmapping);
+  if (e.request != MappingKeyboard && e.request != MappingModifier) {
+    return;
+  }
+  // Keycodes or the NumLock modifier may have changed, so resolve and grab
+  // bindings afresh. This is the only time they are re-grabbed.
+  XUngrabKey(display_, AnyKey, AnyModifier, root_);
+  XUngrabButton(display_, AnyButton, AnyModifier, root_);
+  UpdateNumLockMask();
+  ResolveKeyBindings();
+  GrabBindings();
+}
+
+void WindowManager::WatchConfig() {
+  // 1. Watch the directory rather than the file, as editors typically replace
+  // the file instead of writing to it.
+  const size_t slash = config_path_.rfind('/');
+  const string directory =
+      slash == string::npos ? string(".") : config_path_.substr(0, slash);
+  inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  PCHECK(inotify_fd_ >= 0) << "Failed to create inotify instance";
+  if (inotify_add_watch(
+          inotify_fd_, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    PLOG(WARNING) << "Not watching " << directory << " for changes";
+    close(inotify_fd_);
+    inotify_fd_ = -1;
+    return;
+  }
+  // 2. Have the event loop tell us about changes.
+  event_loop_.Watch(inotify_fd_, [this] { OnConfigDirectoryChanged(); });
+}
+
+void WindowManager::OnConfigDirectoryChanged() {
+  // 1. Drain all events, noting whether any was about the file itself.
+  const string name = config_path_.substr(config_path_.rfind('/') + 1);
+  bool changed = false;
+  alignas(inotify_event) char buffer[4096];
+  ssize_t length;
+  while ((length = read(inotify_fd_, buffer, sizeof(buffer))) > 0) {
+    for (ssize_t i = 0; i < length;) {
+      const inotify_event* event =
+          reinterpret_cast<const inotify_event*>(buffer + i);
+      if (event->len > 0 && name == event->name) {
+        changed = true;
+      }
+      i += sizeof(inotify_event) + event->len;
+    }
+  }
+  // 2. Reload once, however many events there were.
+  if (changed) {
+    ReloadConfig();
+  }
+}
 
+void WindowManager::ReloadConfig() {
+  Stats::Scope scope(&stats_, stats_.Entry("handler", "ReloadConfig"));
+  // 1. Swap in the new configuration.
+  const ::std::shared_ptr<const Config> old_config = config_;
+  config_ = LoadConfig(config_path_);
+  // 2. Restyle existing frames.
+  if (config_->border_width != old_config->border_width ||
+      config_->border_color != old_config->border_color) {
+    for (const Client& client : clients_) {
+      const Window frame = client.frame;
+      if (frame == None) {
+        continue;
       }
-    
+      XSetWindowBorderWidth(display_, frame, config_->border_width);
+      XSetWindowBorder(display_, frame, config_->border_color);
+    }
+  }
+  // The outline GC has the border width baked in.
+  if (outline_gc_ != nullptr && !outline_visible_) {
+    XFreeGC(display_, outline_gc_);
+    outline_gc_ = nullptr;
+  }
+  // 3. Rearrange for new gaps and borders. Tiles are inset after arranging, so
+  // the layouts can't tell on their own.
+  if (config_->gap != old_config->gap ||
+      config_->border_width != old_config->border_width) {
+    for (Monitor& monitor : monitors_) {
+      for (Layout& layout : monitor.layouts) {
+        layout.Invalidate();
+      }
+    }
+    RequestRelayout();
+  }
+  // 4. Grab the new key bindings.
+  XUngrabKey(display_, AnyKey, AnyModifier, root_);
+  XUngrabButton(display_, AnyButton, AnyModifier, root_);
+  ResolveKeyBindings();
+  GrabBindings();
+}
 
+const WindowManager::KeyAction* WindowManager::FindKeyAction(
+    const string& name) {
+  for (const KeyAction& action : KEY_ACTIONS) {
+    if (name == action.name) {
+      return &action;
+    }
   }
+  return nullptr;
+}
 
-  else if ((e.state & Mod1Mask) &&
-      (e.keycode == XKeysymToKeycode(display_, XK_Left))) {
-      Window returned_root, returned_parent;
-      Window* top_level_windows;
-      unsigned int num_top_level_windows;	
-      CHECK(XQueryTree(
-      display_,
-      root_,
-      &returned_root,
-      &returned_parent,
-      &top_level_windows,
-      &num_top_level_windows));
-      XWindowAttributes wattrs;
-      XGetWindowAttributes(display_, clients_[e.window], &wattrs);
-      printf("\nWidth: %d", wattrs.width);
-      if (wattrs.width > 100) {
-       for (int i = 0; i < num_top_level_windows; i++) {
-        XWindowAttributes nwattrs;
-        XGetWindowAttributes(display_, top_level_windows[i], &nwattrs);
-        if (nwattrs.x == wattrs.x + wattrs.width) {
-          printf("Width: \n \n --\n%d\n", nwattrs.width);
-          XMoveWindow(display_, top_level_windows[i], nwattrs.x - 100, nwattrs.y);
-          printf("\nHere\n");
-          Window root_return, parent_return;
-          Window *children_return;
-          unsigned int nchildren_return;
-          XQueryTree(display_, top_level_windows[i], &root_return, &parent_return, &children_return, &nchildren_return);
-          XResizeWindow(display_, children_return[0], nwattrs.width + 100, nwattrs.height);
-          XResizeWindow(display_, top_level_windows[i], nwattrs.width + 100, nwattrs.height);
-	  XResizeWindow(display_, clients_[e.window], wattrs.width - 100, wattrs.height);
-      	  XResizeWindow(display_, e.window, wattrs.width - 100, wattrs.height);
+void WindowManager::ResolveKeyBindings() {
+  key_table_.clear();
+  for (const KeyBinding& binding : config_->key_bindings) {
+    // 1. Look up action.
+    const KeyAction* action = FindKeyAction(binding.action);
+    if (action == nullptr) {
+      LOG(WARNING) << "Ignoring binding to unknown action " << binding.action;
+      continue;
+    }
+    // 2. Resolve keysym against the current keyboard mapping.
+    const KeyCode keycode = XKeysymToKeycode(display_, binding.keysym);
+    if (keycode == 0) {
+      LOG(WARNING) << "No key for keysym " << XKeysymToString(binding.keysym);
+      continue;
+    }
+    ResolvedKeyBinding& resolved =
+        key_table_[KeyTableIndex(keycode, binding.modifiers)];
+    resolved.keycode = keycode;
+    resolved.modifiers = binding.modifiers;
+    resolved.action = action->handler;
+    resolved.needs_client = action->needs_client;
+    resolved.argument = binding.argument;
+    resolved.stats = stats_.Entry(
+        "binding",
+        FormatKeyCombination(binding.modifiers, binding.keysym) + " " +
+            binding.action +
+            (binding.argument.empty() ? "" : " " + binding.argument));
+  }
+}
+
+void WindowManager::GrabBindings() {
+  // Grab every combination with NumLock and CapsLock on or off, as those
+  // modifiers would otherwise keep the grabs from matching.
+  const unsigned int lock_variants[] = {
+      0, LockMask, numlock_mask_, numlock_mask_ | LockMask};
+  for (unsigned int lock : lock_variants) {
+    //   a. Key bindings.
+    for (const auto& binding : key_table_) {
+      XGrabKey(
+          display_,
+          binding.second.keycode,
+          binding.second.modifiers | lock,
+          root_,
+          false,
+          GrabModeAsync,
+          GrabModeAsync);
+    }
+    //   b. Move windows with alt + left button, resize with alt + right
+    //   button.
+    for (unsigned int button : {Button1, Button3}) {
+      XGrabButton(
+          display_,
+          button,
+          Mod1Mask | lock,
+          root_,
+          false,
+          ButtonPressMask | ButtonReleaseMask | ButtonMotionMask,
+          GrabModeAsync,
+          GrabModeAsync,
+          None,
+          None);
+    }
+  }
+}
+
+void WindowManager::UpdateNumLockMask() {
+  numlock_mask_ = 0;
+  XModifierKeymap* modmap = XGetModifierMapping(display_);
+  const KeyCode numlock = XKeysymToKeycode(display_, XK_Num_Lock);
+  for (int i = 0; i < 8; ++i) {
+    for (int j = 0; j < modmap->max_keypermod; ++j) {
+      if (numlock != 0 &&
+          modmap->modifiermap[i * modmap->max_keypermod + j] == numlock) {
+        numlock_mask_ = 1 << i;
+      }
+    }
+  }
+  XFreeModifiermap(modmap);
+}
+
+unsigned int WindowManager::KeyTableIndex(
+    unsigned int keycode, unsigned int state) const {
+  return keycode << 16 | BindingModifiers(state);
+}
+
+unsigned int WindowManager::BindingModifiers(unsigned int state) const {
+  // Lock modifiers and pointer buttons don't take part in matching.
+  return state & ~(LockMask | numlock_mask_) &
+      (ShiftMask | ControlMask | Mod1Mask | Mod2Mask | Mod3Mask | Mod4Mask |
+       Mod5Mask);
+}
+
+void WindowManager::CloseWindow(Window w, const string& arg) {
+  // 1. Clients that can't be asked to close are killed right away, as are
+  // those asked before, which closing again shouldn't keep waiting for.
+  const Client* client = FindClient(w);
+  if (client == nullptr || !client->deletable || kill_timers_.count(w)) {
+    KillWindow(w);
+    return;
+  }
+  // 2. Ask the client to close, which gives it the chance to save its state,
+  // or to ask the user.
+  TRACE(INFO) << "Asking window " << w << " to close";
+  XEvent e;
+  memset(&e, 0, sizeof(e));
+  e.xclient.type = ClientMessage;
+  e.xclient.window = w;
+  e.xclient.message_type = atoms_[WM_PROTOCOLS];
+  e.xclient.format = 32;
+  e.xclient.data.l[0] = atoms_[WM_DELETE_WINDOW];
+  e.xclient.data.l[1] = CurrentTime;
+  XSendEvent(display_, w, false, NoEventMask, &e);
+  // 3. Kill it if it is still around after the timeout. Unframe() cancels the
+  // timer once it is gone.
+  if (config_->kill_timeout > 0) {
+    kill_timers_[w] = event_loop_.AddTimer(
+        config_->kill_timeout, false, [this, w] { OnKillTimeout(w); });
+  }
+}
+
+void WindowManager::OnKillTimeout(Window w) {
+  TRACE(INFO) << "Window " << w << " didn't close in time";
+  KillWindow(w);
+}
+
+void WindowManager::KillWindow(Window w) {
+  auto kill_timer = kill_timers_.find(w);
+  if (kill_timer != kill_timers_.end()) {
+    event_loop_.CancelTimer(kill_timer->second);
+    kill_timers_.erase(kill_timer);
+  }
+  TRACE(INFO) << "Killing window " << w;
+  XKillClient(display_, w);
+}
+
+void WindowManager::ResizeWindow(Window w, const string& arg) {
+  // Grow window into its right neighbor by arg pixels, or shrink it in favor of
+  // its right neighbor if arg is negative. "+" and "-" stand for the
+  // configured step.
+  const int pixels =
+      arg == "+" ? config_->resize_step :
+      arg == "-" ? -config_->resize_step :
+      atoi(arg.c_str());
+  Client* client = FindClient(w);
+  if (LayoutOf(client).Resize(w, pixels, TilingArea(client->monitor))) {
+    RequestRelayout(client->monitor);
+    XRaiseWindow(display_, client->frame);
+  }
+}
+
+void WindowManager::SwapWindow(Window w, const string& arg) {
+  // Swap window with its right or left neighbor.
+  const Client* client = FindClient(w);
+  Layout& layout = LayoutOf(client);
+  const Window neighbor = arg == "left" ? layout.Prev(w) : layout.Next(w);
+  if (neighbor != None) {
+    layout.Swap(w, neighbor);
+    RequestRelayout(client->monitor);
+  }
+}
+
+void WindowManager::TileWindows(Window w, const string& arg) {
+  // Put back every window, including ones moved out of their tiles.
+  for (Monitor& monitor : monitors_) {
+    monitor.layouts[current_workspace_].Invalidate();
+  }
+  RequestRelayout();
+}
+
+void WindowManager::SetLayout(Window w, const string& arg) {
+  const Client* client = w != None ? FindClient(w) : focus_.focused();
+  const size_t monitor = client != nullptr ? client->monitor : 0;
+  Layout& layout = monitors_[monitor].layouts[current_workspace_];
+  LayoutMode mode;
+  if (arg == "next") {
+    mode = layout.mode() == LayoutMode::MONOCLE ?
+        LayoutMode::COLUMNS :
+        static_cast<LayoutMode>(static_cast<int>(layout.mode()) + 1);
+  } else if (!ParseLayoutMode(arg, &mode)) {
+    LOG(WARNING) << "Ignoring unknown layout " << arg;
+    return;
+  }
+  layout.set_mode(mode);
+  RequestRelayout(monitor);
+  TRACE(INFO) << "Layout of monitor " << monitor << " is now "
+              << LayoutModeName(mode);
+}
+
+void WindowManager::SpawnProgram(Window w, const string& arg) {
+  // Without a command, run the configured launcher.
+  Spawn(arg.empty() ? config_->launcher : arg);
+}
+
+void WindowManager::FocusNextWindow(Window w, const string& arg) {
+  // 1. Walk the focus history back from the focused window, or from the one
+  // under the pointer if none is, to the next one on the current workspace.
+  Client* start = focus_.focused();
+  if (start == nullptr) {
+    start = FindClient(w);
+  }
+  if (start == nullptr) {
+    start = focus_.front();
+  }
+  if (start == nullptr) {
+    return;
+  }
+  Client* next = start;
+  do {
+    next = focus_.Next(next);
+  } while (next != start &&
+           (next->workspace != current_workspace_ || !next->placed));
+  if (next == start && start == focus_.focused()) {
+    return;
+  }
+  // 2. Leave the history as it is while the modifiers of the binding are
+  // held. The keyboard is grabbed for the length of the cycle, so that we
+  // see them released. Modifiers released before the grab took effect were
+  // released to the client instead, so the keys are checked once it has; any
+  // release after that comes to us.
+  const unsigned int modifiers = BindingModifiers(key_press_state_);
+  bool cycling = modifiers != 0;
+  if (cycling && !focus_.cycling()) {
+    xcb_connection_t* connection = XGetXCBConnection(display_);
+    xcb_discard_reply(
+        connection,
+        xcb_grab_keyboard(
+            connection, false, root_, XCB_CURRENT_TIME, XCB_GRAB_MODE_ASYNC,
+            XCB_GRAB_MODE_ASYNC).sequence);
+    // Replays carry the releases of the recording, not the keys held now.
+    if (!replaying_ && !ModifiersDown(modifiers)) {
+      XUngrabKeyboard(display_, CurrentTime);
+      cycling = false;
+    }
+  }
+  // 3. Raise and set focus.
+  XRaiseWindow(display_, next->frame);
+  SetFocus(next, cycling);
+}
+
+void WindowManager::FocusWindow(Window w, const string& arg) {
+  Client* client = FindClient(w);
+  if (client->workspace != current_workspace_) {
+    SwitchWorkspace(client->workspace);
+  }
+  XRaiseWindow(display_, client->frame);
+  SetFocus(client, false);
+}
+
+void WindowManager::SetFocus(Client* c, bool cycling) {
+  XSetInputFocus(
+      display_, c != nullptr ? c->window : PointerRoot, RevertToPointerRoot,
+      CurrentTime);
+  UpdateFocus(c, cycling);
+}
+
+void WindowManager::UpdateFocus(Client* c, bool cycling) {
+  focus_.Focus(c, cycling);
+  if (c == nullptr) {
+    return;
+  }
+  // Monocle layouts show the focused window, unless they already do.
+  Layout& layout = LayoutOf(c);
+  const bool shown = layout.current() == c->window;
+  layout.SetCurrent(c->window);
+  if (layout.mode() == LayoutMode::MONOCLE && !shown) {
+    RequestRelayout(c->monitor);
+  }
+}
+
+void WindowManager::FocusMostRecent() {
+  // Windows yet to be placed can't take the focus before they are mapped.
+  Client* c = focus_.front();
+  while (c != nullptr && (c->workspace != current_workspace_ || !c->placed)) {
+    c = c->focus_older;
+  }
+  SetFocus(c, false);
+}
+
+void WindowManager::EndFocusCycle() {
+  XUngrabKeyboard(display_, CurrentTime);
+  focus_.EndCycle();
+}
+
+bool WindowManager::ModifiersDown(unsigned int modifiers) {
+  // Both requests go out together, and cost a single round trip.
+  xcb_connection_t* connection = XGetXCBConnection(display_);
+  const xcb_query_keymap_cookie_t keymap_cookie = xcb_query_keymap(connection);
+  const xcb_get_modifier_mapping_cookie_t modmap_cookie =
+      xcb_get_modifier_mapping(connection);
+  xcb_query_keymap_reply_t* keymap =
+      xcb_query_keymap_reply(connection, keymap_cookie, nullptr);
+  xcb_get_modifier_mapping_reply_t* modmap =
+      xcb_get_modifier_mapping_reply(connection, modmap_cookie, nullptr);
+  bool down = false;
+  if (keymap != nullptr && modmap != nullptr) {
+    const xcb_keycode_t* keycodes = xcb_get_modifier_mapping_keycodes(modmap);
+    const int keys_per_modifier = modmap->keycodes_per_modifier;
+    for (int i = 0; i < 8; ++i) {
+      if (!(modifiers & (1 << i))) {
+        continue;
+      }
+      for (int j = 0; j < keys_per_modifier; ++j) {
+        const xcb_keycode_t keycode = keycodes[i * keys_per_modifier + j];
+        if (keycode != 0 && (keymap->keys[keycode / 8] >> (keycode % 8)) & 1) {
+          down = true;
         }
+      }
+    }
+  }
+  free(keymap);
+  free(modmap);
+  return down;
+}
+
+void WindowManager::RestartWindowManager(Window w, const string& arg) {
+  // The event loop returns, and main() replaces the process with a fresh copy
+  // once Run() has saved the state for it.
+  LOG(INFO) << "Restarting window manager";
+  restart_requested_ = true;
+  event_loop_.Stop();
+}
 
+void WindowManager::SaveState() {
+  // 1. Record every tile on the root window, where the next instance finds it.
+  // The current workspace is already published in _NET_CURRENT_DESKTOP.
+  vector<long> state;
+  state.push_back(STATE_VERSION);
+  for (size_t i = 0; i < monitors_.size(); ++i) {
+    for (size_t j = 0; j < WORKSPACE_COUNT; ++j) {
+      const vector<::std::pair<Window, double>> tiles =
+          monitors_[i].layouts[j].Tiles();
+      double total_weight = 0;
+      for (const auto& tile : tiles) {
+        total_weight += tile.second;
       }
-      printf("\n WidthofWin: %d", wattrs.width - 100);
+      for (const auto& tile : tiles) {
+        state.push_back(tile.first);
+        state.push_back(FindClient(tile.first)->frame);
+        state.push_back(max(
+            ::std::lround(tile.second / total_weight * STATE_WEIGHT_SCALE),
+            1L));
+        state.push_back(i);
+        state.push_back(j);
       }
+    }
+  }
+  XChangeProperty(
+      display_,
+      root_,
+      atoms_[BASIC_WM_STATE],
+      XA_CARDINAL,
+      32,
+      PropModeReplace,
+      reinterpret_cast<const unsigned char*>(state.data()),
+      state.size());
+  // 2. Keep our frames alive after we disconnect. Save set processing would
+  // still reparent clients out of them, so take the clients out of it.
+  for (const Client& client : clients_) {
+    XRemoveFromSaveSet(display_, client.window);
   }
+  XSetCloseDownMode(display_, RetainTemporary);
+  XSync(display_, false);
+}
 
-  else if ((e.state & Mod1Mask) && //swap window to right
-      (e.keycode == XKeysymToKeycode(display_, XK_D))){
-      Window returned_root, returned_parent;
-      Window* top_level_windows;
-      unsigned int num_top_level_windows;
-      CHECK(XQueryTree(
+::std::unordered_map<Window, WindowManager::SavedFrame>
+WindowManager::ReadSavedState() {
+  ::std::unordered_map<Window, SavedFrame> saved_frames;
+  // 1. Fetch and delete the state, so that it is only ever used once.
+  Atom actual_type;
+  int actual_format;
+  unsigned long num_items, bytes_after;
+  long* state = nullptr;
+  if (XGetWindowProperty(
           display_,
           root_,
-          &returned_root,
-          &returned_parent,
-          &top_level_windows,
-          &num_top_level_windows));
-      for (int i = 0; i < num_top_level_windows; i++) {
-        XWindowAttributes wattrs, nwattrs;
-        XGetWindowAttributes(display_, clients_[e.window], &wattrs);
-        XGetWindowAttributes(display_, top_level_windows[i], &nwattrs);
-        if (nwattrs.x == wattrs.x + wattrs.width) {
-             Window root_return;
-             Window parent_return;
-             Window *children_return;
-             unsigned int nchildren_return;
-
-            XQueryTree(display_, top_level_windows[i], &root_return, &parent_return, &children_return, &nchildren_return);
-            XMoveWindow(display_, clients_[e.window], nwattrs.x, nwattrs.y);
-            XMoveWindow(display_, top_level_windows[i], wattrs.x, wattrs.y);
-            XResizeWindow(display_, clients_[e.window], nwattrs.width, nwattrs.height);
-            XResizeWindow(display_, e.window, nwattrs.width, nwattrs.height);
-            XResizeWindow(display_, top_level_windows[i], wattrs.width, wattrs.height);
-            XResizeWindow(display_, children_return[0], wattrs.width, wattrs.height);
-            break;
-
-        } 
-      }
+          atoms_[BASIC_WM_STATE],
+          0, (~0L),
+          true,
+          XA_CARDINAL,
+          &actual_type,
+          &actual_format,
+          &num_items,
+          &bytes_after,
+          reinterpret_cast<unsigned char**>(&state)) != Success ||
+      state == nullptr) {
+    return saved_frames;
+  }
+  // 2. Index the tiles by frame.
+  if (actual_format == 32 && num_items >= 1 && state[0] == STATE_VERSION &&
+      (num_items - 1) % 5 == 0) {
+    for (unsigned long i = 1; i < num_items; i += 5) {
+      SavedFrame& frame = saved_frames[state[i + 1]];
+      frame.window = state[i];
+      frame.weight = state[i + 2] / STATE_WEIGHT_SCALE;
+      frame.monitor = state[i + 3];
+      frame.workspace = state[i + 4];
+      frame.tile = i / 5;
+    }
+    LOG(INFO) << "Restoring " << saved_frames.size() << " frames";
+  } else {
+    LOG(WARNING) << "Ignoring malformed window manager state";
+  }
+  XFree(state);
+  return saved_frames;
+}
 
+void WindowManager::ReleaseClients() {
+  // Frames taken over from a previous instance belong to its connection, so
+  // would outlive ours along with the clients in them. Reparent every client
+  // back to the root window where its frame was.
+  for (const Client& client : clients_) {
+    if (client.frame == None) {
+      continue;
+    }
+    XReparentWindow(
+        display_,
+        client.window,
+        root_,
+        client.frame_pos.x, client.frame_pos.y);
+    XRemoveFromSaveSet(display_, client.window);
+    XDestroyWindow(display_, client.frame);
+  }
+  XSync(display_, false);
+}
+
+void WindowManager::ShowWorkspace(Window w, const string& arg) {
+  size_t workspace;
+  if (ParseWorkspace(arg, &workspace)) {
+    SwitchWorkspace(workspace);
+  }
+}
+
+void WindowManager::MoveToWorkspace(Window w, const string& arg) {
+  size_t workspace;
+  if (ParseWorkspace(arg, &workspace)) {
+    AssignWorkspace(FindClient(w), workspace);
   }
-	
-  else if ((e.state & Mod1Mask) && //swap window to right
-      (e.keycode == XKeysymToKeycode(display_, XK_A))){
-      Window returned_root, returned_parent;
-      Window* top_level_windows;
-      unsigned int num_top_level_windows;
-      CHECK(XQueryTree(
+}
+
+void WindowManager::SwitchWorkspace(size_t workspace) {
+  if (workspace == current_workspace_) {
+    return;
+  }
+  // 1. Map the frames of the new workspace before unmapping the old ones, so
+  // that the root window doesn't show through in between. Frames are only ever
+  // unmapped, never destroyed, and their UnmapNotify events are ignored, as
+  // only client windows are unframed on UnmapNotify.
+  for (const Client& client : clients_) {
+    if (client.frame != None && client.workspace == workspace) {
+      XMapWindow(display_, client.frame);
+    }
+  }
+  for (const Client& client : clients_) {
+    if (client.frame != None && client.workspace == current_workspace_) {
+      XUnmapWindow(display_, client.frame);
+    }
+  }
+  current_workspace_ = workspace;
+  // 2. Layout changes made while the workspace was hidden were never applied.
+  RequestRelayout();
+  // 3. Focus follows the workspace.
+  FocusMostRecent();
+  PublishWorkspaces();
+  TRACE(INFO) << "Switched to workspace " << workspace + 1;
+}
+
+void WindowManager::AssignWorkspace(Client* c, size_t workspace) {
+  if (c->workspace == workspace) {
+    return;
+  }
+  if (c->workspace == current_workspace_) {
+    RequestRelayout(c->monitor);
+  }
+  LayoutOf(c).Remove(c->window);
+  c->workspace = workspace;
+  LayoutOf(c).Insert(c->window);
+  if (workspace == current_workspace_) {
+    XMapWindow(display_, c->frame);
+    RequestRelayout(c->monitor);
+  } else {
+    XUnmapWindow(display_, c->frame);
+    if (c == focus_.focused()) {
+      FocusMostRecent();
+    }
+  }
+}
+
+bool WindowManager::ParseWorkspace(const string& arg, size_t* workspace) {
+  const int n = atoi(arg.c_str());
+  if (n < 1 || static_cast<size_t>(n) > WORKSPACE_COUNT) {
+    LOG(WARNING) << "No workspace " << arg;
+    return false;
+  }
+  *workspace = n - 1;
+  return true;
+}
+
+void WindowManager::PublishWorkspaces() {
+  const long count = WORKSPACE_COUNT;
+  XChangeProperty(
+      display_,
+      root_,
+      atoms_[NET_NUMBER_OF_DESKTOPS],
+      XA_CARDINAL,
+      32,
+      PropModeReplace,
+      reinterpret_cast<const unsigned char*>(&count),
+      1);
+  const long current = current_workspace_;
+  XChangeProperty(
+      display_,
+      root_,
+      atoms_[NET_CURRENT_DESKTOP],
+      XA_CARDINAL,
+      32,
+      PropModeReplace,
+      reinterpret_cast<const unsigned char*>(&current),
+      1);
+  // Workspaces are named by their number, as in the key bindings.
+  string names;
+  for (size_t i = 1; i <= WORKSPACE_COUNT; ++i) {
+    names += ::std::to_string(i);
+    names += '\0';
+  }
+  XChangeProperty(
+      display_,
+      root_,
+      atoms_[NET_DESKTOP_NAMES],
+      atoms_[UTF8_STRING],
+      8,
+      PropModeReplace,
+      reinterpret_cast<const unsigned char*>(names.data()),
+      names.size());
+}
+
+void WindowManager::ReadCurrentWorkspace() {
+  Atom actual_type;
+  int actual_format;
+  unsigned long num_items, bytes_after;
+  long* current = nullptr;
+  if (XGetWindowProperty(
           display_,
           root_,
-          &returned_root,
-          &returned_parent,
-          &top_level_windows,
-          &num_top_level_windows));
-      for (int i = 0; i < num_top_level_windows; i++) {
-        XWindowAttributes wattrs, nwattrs;
-        XGetWindowAttributes(display_, clients_[e.window], &wattrs);
-        XGetWindowAttributes(display_, top_level_windows[i], &nwattrs);
-        if (nwattrs.x + nwattrs.width == wattrs.x) {
-             Window root_return;
-             Window parent_return;
-             Window *children_return;
-             unsigned int nchildren_return;
-
-            XQueryTree(display_, top_level_windows[i], &root_return, &parent_return, &children_return, &nchildren_return);
-            XMoveWindow(display_, clients_[e.window], nwattrs.x, nwattrs.y);
-            XMoveWindow(display_, top_level_windows[i], wattrs.x, wattrs.y);
-            XResizeWindow(display_, clients_[e.window], nwattrs.width, nwattrs.height);
-            XResizeWindow(display_, e.window, nwattrs.width, nwattrs.height);
-            XResizeWindow(display_, top_level_windows[i], wattrs.width, wattrs.height);
-            XResizeWindow(display_, children_return[0], wattrs.width, wattrs.height);
-            break;
-
-        } 
-      }
+          atoms_[NET_CURRENT_DESKTOP],
+          0, 1,
+          false,
+          XA_CARDINAL,
+          &actual_type,
+          &actual_format,
+          &num_items,
+          &bytes_after,
+          reinterpret_cast<unsigned char**>(&current)) != Success ||
+      current == nullptr) {
+    return;
+  }
+  if (actual_format == 32 && num_items == 1 && *current >= 0 &&
+      static_cast<size_t>(*current) < WORKSPACE_COUNT) {
+    current_workspace_ = *current;
+  }
+  XFree(current);
+}
 
+void WindowManager::PublishSupport() {
+  // 1. Create the check window, which identifies us to clients by name.
+  check_window_ = XCreateSimpleWindow(display_, root_, -1, -1, 1, 1, 0, 0, 0);
+  for (Window w : {root_, check_window_}) {
+    XChangeProperty(
+        display_,
+        w,
+        atoms_[NET_SUPPORTING_WM_CHECK],
+        XA_WINDOW,
+        32,
+        PropModeReplace,
+        reinterpret_cast<const unsigned char*>(&check_window_),
+        1);
   }
+  static const char NAME[] = "basic_wm";
+  XChangeProperty(
+      display_,
+      check_window_,
+      atoms_[NET_WM_NAME],
+      atoms_[UTF8_STRING],
+      8,
+      PropModeReplace,
+      reinterpret_cast<const unsigned char*>(NAME),
+      sizeof(NAME) - 1);
+  // 2. List the hints we maintain, and drop what a previous window manager
+  // may have left behind.
+  XDeleteProperty(display_, root_, atoms_[NET_ACTIVE_WINDOW]);
+  vector<Atom> supported;
+  for (AtomName atom : SUPPORTED_ATOMS) {
+    supported.push_back(atoms_[atom]);
+  }
+  XChangeProperty(
+      display_,
+      root_,
+      atoms_[NET_SUPPORTED],
+      XA_ATOM,
+      32,
+      PropModeReplace,
+      reinterpret_cast<const unsigned char*>(supported.data()),
+      supported.size());
+}
+
+void WindowManager::AddToClientList(Window w) {
+  client_list_.push_back(w);
+}
 
-  else if ((e.state & Mod1Mask) &&
-      (e.keycode == XKeysymToKeycode(display_, XK_T))){
-      
-      iterateWindows();
+void WindowManager::RemoveFromClientList(Window w) {
+  auto i = ::std::find(client_list_.begin(), client_list_.end(), w);
+  if (i == client_list_.end()) {
+    return;
   }
-  else if ((e.state & Mod1Mask) &&
-      (e.keycode == XKeysymToKeycode(display_, XK_Return))){
-      system("rofi -show drun");
+  // A property can't lose an entry in the middle, so it is rewritten.
+  client_list_.erase(i);
+  client_list_published_ = -1;
+}
 
+void WindowManager::UpdateRootProperties() {
+  // 1. Append new clients to _NET_CLIENT_LIST, or rewrite it after removals.
+  // It is written in full the first time, as it may still list the clients of
+  // a previous window manager.
+  const int count = client_list_.size();
+  if (client_list_published_ != count) {
+    const bool rewrite = client_list_published_ < 0;
+    const int first = rewrite ? 0 : client_list_published_;
+    XChangeProperty(
+        display_,
+        root_,
+        atoms_[NET_CLIENT_LIST],
+        XA_WINDOW,
+        32,
+        rewrite ? PropModeReplace : PropModeAppend,
+        reinterpret_cast<const unsigned char*>(client_list_.data() + first),
+        count - first);
+    client_list_published_ = count;
+  }
+  // 2. Active window.
+  const Window active_window =
+      focus_.focused() != nullptr ? focus_.focused()->window : None;
+  if (active_window != published_active_window_) {
+    XChangeProperty(
+        display_,
+        root_,
+        atoms_[NET_ACTIVE_WINDOW],
+        XA_WINDOW,
+        32,
+        PropModeReplace,
+        reinterpret_cast<const unsigned char*>(&active_window),
+        1);
+    published_active_window_ = active_window;
+  }
+  // 3. The work area is the same on all workspaces: everything the monitors
+  // span, except the bar along the top.
+  const int bar_height = getBarHeight();
+  Rect workarea(0, bar_height, 0, -bar_height);
+  for (const Monitor& monitor : monitors_) {
+    workarea.width = max(
+        workarea.width, monitor.geometry.x + monitor.geometry.width);
+    workarea.height = max(
+        workarea.height,
+        monitor.geometry.y + monitor.geometry.height - bar_height);
   }
-  else if ((e.state & Mod1Mask) &&
-             (e.keycode == XKeysymToKeycode(display_, XK_Tab))) {
-    // alt + tab: Switch window.
-    // 1. Find next window.
-    auto i = clients_.find(e.window);
-    CHECK(i != clients_.end());
-    ++i;
-    if (i == clients_.end()) {
-      i = clients_.begin();
+  if (workarea != published_workarea_) {
+    vector<long> values;
+    for (size_t i = 0; i < WORKSPACE_COUNT; ++i) {
+      values.insert(
+          values.end(),
+          {workarea.x, workarea.y, workarea.width, workarea.height});
     }
-    // 2. Raise and set focus.
-    XRaiseWindow(display_, i->second);
-    XSetInputFocus(display_, i->first, RevertToPointerRoot, CurrentTime);
+    XChangeProperty(
+        display_,
+        root_,
+        atoms_[NET_WORKAREA],
+        XA_CARDINAL,
+        32,
+        PropModeReplace,
+        reinterpret_cast<const unsigned char*>(values.data()),
+        values.size());
+    published_workarea_ = workarea;
   }
 }
 
-void WindowManager::OnKeyRelease(const XKeyEvent& e) {}
+void WindowManager::OnClientMessage(const XClientMessageEvent& e) {
+  // Pagers and bars switch workspaces by asking us to on the root window.
+  if (e.message_type == atoms_[NET_CURRENT_DESKTOP] && e.format == 32 &&
+      e.data.l[0] >= 0 &&
+      static_cast<size_t>(e.data.l[0]) < WORKSPACE_COUNT) {
+    SwitchWorkspace(e.data.l[0]);
+  }
+}
+
+void WindowManager::OnKeyRelease(const XKeyEvent& e) {
+  if (!focus_.cycling()) {
+    return;
+  }
+  XKeyEvent key = e;
+  if (!IsModifierKey(XLookupKeysym(&key, 0))) {
+    return;
+  }
+  EndFocusCycle();
+}
+
+void WindowManager::OnFocusIn(const XFocusChangeEvent& e) {
+  // Focus moving in and out of a window because of keyboard grabs, such as
+  // those of our own bindings, or only because the pointer is in it, doesn't
+  // count.
+  if (e.mode == NotifyGrab || e.mode == NotifyUngrab ||
+      e.detail == NotifyPointer || e.detail == NotifyPointerRoot ||
+      e.detail == NotifyDetailNone) {
+    return;
+  }
+  // Focus we set ourselves is already recorded, so this only picks up
+  // clients that take the focus by themselves.
+  Client* client = FindClient(e.window);
+  if (client == nullptr || client->frame == None ||
+      client == focus_.focused()) {
+    return;
+  }
+  UpdateFocus(client, false);
+}
+
+void WindowManager::OnEnterNotify(const XCrossingEvent& e) {
+  // Only the pointer entering a frame from outside counts: not moving between
+  // frame and client, nor crossings from grabs, or from drags.
+  if (!config_->focus_follows_mouse || e.mode != NotifyNormal ||
+      e.detail == NotifyInferior || drag_window_ != None ||
+      focus_.cycling()) {
+    return;
+  }
+  Client* client = FindClientByFrame(e.window);
+  if (client == nullptr || client == focus_.focused()) {
+    return;
+  }
+  SetFocus(client, false);
+}
+
+Client* WindowManager::FindClient(Window w) {
+  return clients_.Find(w);
+}
+
+Client* WindowManager::FindClientByFrame(Window frame) {
+  return clients_.FindByFrame(frame);
+}
+
+void WindowManager::ConfigureFrame(Client* c, const Rect& r) {
+  // 1. Resize the client window to fill the frame first, so that a frame that
+  // grows is already covered by the client when it does. Frames have no
+  // background, so any part of them left uncovered would show garbage until
+  // the client caught up. Both requests go out in the same batch.
+  XWindowChanges changes;
+  changes.x = r.x;
+  changes.y = r.y;
+  changes.width = r.width;
+  changes.height = r.height;
+  unsigned int client_mask = 0;
+  if (c->client_size.width != r.width) {
+    client_mask |= CWWidth;
+  }
+  if (c->client_size.height != r.height) {
+    client_mask |= CWHeight;
+  }
+  if (client_mask) {
+    XConfigureWindow(display_, c->window, client_mask, &changes);
+  }
+  // 2. Reconfigure frame.
+  unsigned int frame_mask = 0;
+  if (c->frame_pos.x != r.x) {
+    frame_mask |= CWX;
+  }
+  if (c->frame_pos.y != r.y) {
+    frame_mask |= CWY;
+  }
+  if (c->frame_size.width != r.width) {
+    frame_mask |= CWWidth;
+  }
+  if (c->frame_size.height != r.height) {
+    frame_mask |= CWHeight;
+  }
+  if (frame_mask) {
+    XConfigureWindow(display_, c->frame, frame_mask, &changes);
+  }
+  // 3. Update cached geometry.
+  c->frame_pos = Position<int>(r.x, r.y);
+  c->frame_size = Size<int>(r.width, r.height);
+  c->client_size = c->frame_size;
+}
 
 int WindowManager::OnXError(Display* display, XErrorEvent* e) {
   const int MAX_ERROR_TEXT_LENGTH = 1024;
@@ -735,83 +2420,131 @@ int WindowManager::OnWMDetected(Display* display, XErrorEvent* e) {
   wm_detected_ = true;
   return 0;
 }
-int WindowManager::GetScreenHeight(Display* display) {
-    Screen *screen;
-
-    display = XOpenDisplay(NULL);
-
-    screen = ScreenOfDisplay(display, 0); //No multi monitor support yet 
-    
-    return screen->height;
+void WindowManager::OnScreenChangeNotify(const XEvent& e) {
+  // Let Xlib update its idea of the screen size before reading it back.
+  XEvent event = e;
+  XRRUpdateConfiguration(&event);
+  UpdateMonitors();
+  UpdateDragInterval();
+}
 
+void WindowManager::UpdateMonitors() {
+  // 1. Fetch the active monitors, falling back to the whole screen as one
+  // monitor without RandR 1.5 or active outputs.
+  vector<Rect> geometries;
+  if (randr_event_base_ >= 0) {
+    int n = 0;
+    XRRMonitorInfo* monitors = XRRGetMonitors(display_, root_, true, &n);
+    for (int i = 0; i < n; ++i) {
+      geometries.emplace_back(
+          monitors[i].x, monitors[i].y, monitors[i].width, monitors[i].height);
+    }
+    if (monitors != nullptr) {
+      XRRFreeMonitors(monitors);
+    }
+  }
+  if (geometries.empty()) {
+    const int screen = DefaultScreen(display_);
+    geometries.emplace_back(
+        0, 0, DisplayWidth(display_, screen), DisplayHeight(display_, screen));
+  }
+  // 2. Windows on monitors that went away are tiled on the first one.
+  const size_t old_count = monitors_.size();
+  if (geometries.size() < old_count) {
+    for (Client& client : clients_) {
+      if (client.frame != None && client.monitor >= geometries.size()) {
+        AssignMonitor(&client, 0);
+        RequestRelayout(0);
+      }
+    }
+  }
+  monitors_.resize(geometries.size());
+  // 3. Only monitors that were added or changed need a relayout.
+  for (size_t i = 0; i < monitors_.size(); ++i) {
+    if (i < old_count && monitors_[i].geometry == geometries[i]) {
+      continue;
+    }
+    monitors_[i].geometry = geometries[i];
+    RequestRelayout(i);
+    LOG(INFO) << "Monitor " << i << " is now "
+              << Size<int>(geometries[i].width, geometries[i].height) << " at "
+              << Position<int>(geometries[i].x, geometries[i].y);
+  }
 }
-int WindowManager::GetScreenWidth(Display* display) {
-  Screen *screen;
-  display = XOpenDisplay(NULL);
 
-  screen = ScreenOfDisplay(display, 0);
-  return screen->width;
+Position<int> WindowManager::QueryPointer() {
+  Window returned_root, returned_child;
+  int root_x = 0, root_y = 0;
+  int win_x, win_y;
+  unsigned int mask;
+  XQueryPointer(
+      display_,
+      root_,
+      &returned_root,
+      &returned_child,
+      &root_x, &root_y,
+      &win_x, &win_y,
+      &mask);
+  return Position<int>(root_x, root_y);
 }
 
-struct Tuple WindowManager::getCursor(Display *display) {
-    int number_of_screens;
-    int i;
-    Bool result;
-    Window window_returned;
-    int root_x, root_y;
-    int win_x, win_y;
-    unsigned int mask_return;
-    
-    number_of_screens = XScreenCount(display);
-    Window *root_windows = new Window(sizeof(Window) * number_of_screens);
-    for (i = 0; i < number_of_screens; i++) {
-        root_windows[i] = XRootWindow(display, i);
+WindowType WindowManager::ClassifyWindowType(const Atom* types, size_t n) {
+  // Status bars and desktop windows are both kept out of the layout.
+  for (size_t i = 0; i < n; ++i) {
+    if (types[i] == atoms_[NET_WM_WINDOW_TYPE_DOCK] ||
+        types[i] == atoms_[NET_WM_WINDOW_TYPE_DESKTOP]) {
+      return WindowType::DOCK;
     }
-    for (i = 0; i < number_of_screens; i++) {
-        result = XQueryPointer(display, root_windows[i], &window_returned,
-                &window_returned, &root_x, &root_y, &win_x, &win_y,
-                &mask_return);
-        if (result == True) {
-            break;
-        }
-    }
-    XFree(root_windows);
-    struct Tuple CursorPos = {.x = root_x, .y = root_y};
-    return CursorPos;
+  }
+  return WindowType::NORMAL;
 }
 
-int WindowManager::isBar(Window w) { //helper function to check if selected window is using an EWMH atom to express as a status bar
-  Atom net_wm_window_type = XInternAtom(display_, "_NET_WM_WINDOW_TYPE", False);
-  Atom net_wm_window_type_dock = XInternAtom(display_, "_NET_WM_WINDOW_TYPE_DOCK", False);
-  Atom net_wm_window_type_desktop = XInternAtom(display_, "_NET_WM_WINDOW_TYPE_DESKTOP", False);
-
-  
+WindowType WindowManager::ReadWindowType(Window w) {
   Atom actual_type;
   int actual_format;
   unsigned long num_items, bytes_after;
-  Atom *property = NULL;
-  
-  if (XGetWindowProperty(display_, w, net_wm_window_type, 0, (~0L), False, XA_ATOM, &actual_type, &actual_format, &num_items, &bytes_after, (unsigned char **)&property) == Success) {
-        if (property != NULL) {
-            for (unsigned long i = 0; i < num_items; i++) {
-                if (property[i] == net_wm_window_type_dock || property[i] == net_wm_window_type_desktop) {
-                    return 1; //bar detected
-
-                }
-            }
-            XFree(property);
-        }
-    }
-return 0; //normal window
+  Atom* property = nullptr;
+  if (XGetWindowProperty(
+          display_,
+          w,
+          atoms_[NET_WM_WINDOW_TYPE],
+          0, (~0L),
+          false,
+          XA_ATOM,
+          &actual_type,
+          &actual_format,
+          &num_items,
+          &bytes_after,
+          reinterpret_cast<unsigned char**>(&property)) != Success ||
+      property == nullptr) {
+    return WindowType::NORMAL;
+  }
+  const WindowType type = ClassifyWindowType(property, num_items);
+  XFree(property);
+  return type;
 }
 
 
+bool WindowManager::HasDeleteProtocol(const Atom* protocols, size_t n) {
+  return ::std::find(protocols, protocols + n, atoms_[WM_DELETE_WINDOW]) !=
+         protocols + n;
+}
+
+bool WindowManager::ReadDeletable(Window w) {
+  Atom* protocols = nullptr;
+  int n = 0;
+  if (!XGetWMProtocols(display_, w, &protocols, &n)) {
+    return false;
+  }
+  const bool deletable = HasDeleteProtocol(protocols, n);
+  XFree(protocols);
+  return deletable;
+}
+
 int WindowManager::getBarHeight() {
-  XWindowAttributes wattrs;
-  XGetWindowAttributes(display_, bar_, &wattrs);
-  printf("\n\nHeight: %d\n\n", wattrs.height);
-  if (wattrs.height < -1000 or wattrs.height > 1000) { //workaround for preventing corrupt results
+  const Client* bar = FindClient(bar_);
+  if (bar == nullptr || !bar->mapped) {
     return 0;
   }
-  return wattrs.height;
+  return bar->frame_size.height;
 }
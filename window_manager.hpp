@@ -4,10 +4,22 @@
 extern "C" {
 #include <X11/Xlib.h>
 }
+#include <chrono>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <unordered_map>
+#include <vector>
+#include "client.hpp"
+#include "client_table.hpp"
+#include "config.hpp"
+#include "event_loop.hpp"
+#include "focus.hpp"
+#include "ipc.hpp"
+#include "key_bindings.hpp"
+#include "layout.hpp"
+#include "recording.hpp"
+#include "stats.hpp"
 #include "util.hpp"
 
 
@@ -24,14 +36,80 @@ class WindowManager {
 
   // The entry point to this class. Enters the main event loop.
   void Run();
+  // Whether Run() returned because a restart was requested. The caller is then
+  // expected to execute the window manager afresh, which takes over the
+  // existing frames without re-framing or rearranging anything.
+  bool restart_requested() const { return restart_requested_; }
 
  private:
   // Invoked internally by Create().
   WindowManager(Display* display);
   // Frames a top-level window.
   void Frame(Window w, bool was_created_before_window_manager);
+  // Frames a top-level window whose attributes are already known.
+  void Frame(
+      Window w, const Rect& geometry, bool mapped, WindowType type,
+      bool deletable);
+  // A frame left behind by the instance we were restarted from.
+  struct SavedFrame {
+    // The client window in the frame.
+    Window window;
+    // Monitor, workspace, layout weight and position of the tile.
+    size_t monitor;
+    size_t workspace;
+    double weight;
+    size_t tile;
+  };
+  // Frames the given pre-existing top-level windows that are visible and
+  // don't set override_redirect, fetching their attributes in one batch.
+  // Windows found in saved_frames are taken over as they are instead.
+  void AdoptWindows(
+      const Window* windows,
+      unsigned int n,
+      const ::std::unordered_map<Window, SavedFrame>& saved_frames);
+  // Takes over a frame of a previous instance holding the saved client.
+  void AdoptFrame(
+      Window frame, const SavedFrame& saved, const Rect& frame_geometry,
+      const Rect& client_geometry, bool deletable);
+  // Records all frames and the layout in the _BASIC_WM_STATE property of the
+  // root window, and keeps the frames alive after we disconnect.
+  void SaveState();
+  // Reads and deletes the state saved by a previous instance. Returns the
+  // saved frames, indexed by frame window.
+  ::std::unordered_map<Window, SavedFrame> ReadSavedState();
+  // Unframes all clients before exiting.
+  void ReleaseClients();
   // Unframes a client window.
   void Unframe(Window w);
+  // Serves the display until the event loop is stopped, recording the
+  // session to $BASIC_WM_RECORD if that is set.
+  void ServeDisplay();
+  // Dispatches the events of a recording as fast as possible, against stand-in
+  // windows for the recorded clients, and logs the statistics. Events the
+  // display sends meanwhile are dropped, as their recorded counterparts are
+  // replayed instead.
+  void ReplayRecording(const ::std::string& path);
+  // Dispatches all queued X events, then finishes the batch.
+  void ProcessXEvents();
+  // Applies what a batch of events or commands changed: relayouts, updates
+  // root window properties and flushes, once for the whole batch.
+  void FinishBatch();
+  // Executes a message of IPC commands as one batch. Returns a line of JSON
+  // for each command.
+  ::std::string HandleIpcCommands(const ::std::vector<::std::string>& commands);
+  // Executes a single IPC command, and returns its JSON reply without a
+  // newline.
+  ::std::string HandleIpcCommand(const ::std::string& command);
+  // Returns the JSON reply to query-clients.
+  ::std::string QueryClients();
+  // Returns the JSON reply to stats, and resets the statistics if arg is
+  // "reset".
+  ::std::string QueryStats(const ::std::string& arg);
+  // Returns the statistics entry X events of the given type are measured in.
+  StatsEntry* EventStats(int type);
+  // Invokes the handler for e. May consume further queued events that e
+  // supersedes, in which case e is updated to the last of them.
+  void DispatchEvent(XEvent& e);
 
   // Event handlers.
   void OnCreateNotify(const XCreateWindowEvent& e);
@@ -42,17 +120,161 @@ class WindowManager {
   void OnConfigureNotify(const XConfigureEvent& e);
   void OnMapRequest(const XMapRequestEvent& e);
   void OnConfigureRequest(const XConfigureRequestEvent& e);
+  void OnPropertyNotify(const XPropertyEvent& e);
   void OnButtonPress(const XButtonEvent& e);
   void OnButtonRelease(const XButtonEvent& e);
   void OnMotionNotify(const XMotionEvent& e);
+  // Applies the latest pointer motion of a move/resize, if there was any since
+  // the last tick, and stops the drag timer otherwise.
+  void OnDragTimer();
+  // Moves or resizes the window being dragged to follow drag_pos_.
+  void ApplyDrag();
+  // Draws (or, drawn again, erases) a resize outline on the root window.
+  void DrawOutline(const Rect& r);
+  // Sets drag_interval_ms_ from the display's refresh rate.
+  void UpdateDragInterval();
   void OnKeyPress(const XKeyEvent& e);
+  // Ends a focus cycle when a modifier is released.
   void OnKeyRelease(const XKeyEvent& e);
-  int GetScreenHeight(Display* display);
-  int GetScreenWidth(Display* display);
-  void iterateWindows();
+  void OnFocusIn(const XFocusChangeEvent& e);
+  void OnEnterNotify(const XCrossingEvent& e);
+  void OnMappingNotify(const XMappingEvent& e);
+  // Starts watching the configuration file for changes.
+  void WatchConfig();
+  // Reads the inotify events for the configuration directory, and reloads the
+  // configuration if the file changed.
+  void OnConfigDirectoryChanged();
+  // Reloads the configuration file, and applies what changed.
+  void ReloadConfig();
+  void OnClientMessage(const XClientMessageEvent& e);
+
+  // Rebuilds key_table_ from the configured key bindings for the current
+  // keyboard mapping.
+  void ResolveKeyBindings();
+  // Grabs all key bindings and the move/resize buttons on the root window.
+  void GrabBindings();
+  // Determines which modifier NumLock is mapped to.
+  void UpdateNumLockMask();
+  // Returns the key_table_ index of a key press with the given keycode and
+  // modifier state.
+  unsigned int KeyTableIndex(unsigned int keycode, unsigned int state) const;
+  // Returns the modifiers of state that take part in matching key bindings.
+  unsigned int BindingModifiers(unsigned int state) const;
+
+  // Key binding actions. w is the client under the pointer when the key was
+  // pressed, or None, and arg is the argument of the binding.
+  void CloseWindow(Window w, const ::std::string& arg);
+  void ResizeWindow(Window w, const ::std::string& arg);
+  void SwapWindow(Window w, const ::std::string& arg);
+  void TileWindows(Window w, const ::std::string& arg);
+  // Sets the layout mode of the current workspace on w's monitor, or on the
+  // focused window's if w is None. arg names a mode, or is "next" to cycle
+  // through them.
+  void SetLayout(Window w, const ::std::string& arg);
+  void SpawnProgram(Window w, const ::std::string& arg);
+  // Focuses the window on the current workspace focused before the focused
+  // one. While the modifiers of the binding are held, repeated presses walk
+  // further back, rather than alternating between two windows.
+  void FocusNextWindow(Window w, const ::std::string& arg);
+  void FocusWindow(Window w, const ::std::string& arg);
+  void RestartWindowManager(Window w, const ::std::string& arg);
+  void ShowWorkspace(Window w, const ::std::string& arg);
+  void MoveToWorkspace(Window w, const ::std::string& arg);
+  // Gives c, or no client if it is nullptr, the input focus, and records it as
+  // focused. cycling is as for FocusList::Focus().
+  void SetFocus(Client* c, bool cycling);
+  // Records c as focused after it received the input focus, and shows it if
+  // its layout only shows one window.
+  void UpdateFocus(Client* c, bool cycling);
+  // Focuses the most recently focused client on the current workspace, if
+  // there is one.
+  void FocusMostRecent();
+  // Ends the focus cycle, releasing the keyboard grab taken for it.
+  void EndFocusCycle();
+  // Whether any key of the given modifiers is currently held down.
+  bool ModifiersDown(unsigned int modifiers);
+  // Shows the given workspace on all monitors and hides the current one.
+  void SwitchWorkspace(size_t workspace);
+  // Moves c into the layout of the given workspace, hiding it if that isn't
+  // the current one.
+  void AssignWorkspace(Client* c, size_t workspace);
+  // Parses a 1-based workspace number. Returns false if arg isn't one.
+  static bool ParseWorkspace(const ::std::string& arg, size_t* workspace);
+  // Publishes the workspace count and current workspace on the root window.
+  void PublishWorkspaces();
+  // Reads back the current workspace published by a previous instance, if
+  // there is one.
+  void ReadCurrentWorkspace();
+
+  // Creates the _NET_SUPPORTING_WM_CHECK window and publishes the EWMH hints
+  // we support.
+  void PublishSupport();
+  // Tracks w in _NET_CLIENT_LIST from the next UpdateRootProperties() on.
+  void AddToClientList(Window w);
+  void RemoveFromClientList(Window w);
+  // Brings _NET_CLIENT_LIST, _NET_ACTIVE_WINDOW and _NET_WORKAREA up to date
+  // with the client model. Only properties that changed are written, and new
+  // clients are appended rather than rewriting the whole list.
+  void UpdateRootProperties();
+  // Returns the record of the managed window w, or nullptr if w isn't one.
+  Client* FindClient(Window w);
+  // Returns the record of the client framed by frame, or nullptr if frame
+  // isn't one of our frames.
+  Client* FindClientByFrame(Window frame);
+  // Moves and resizes c's frame to r and resizes the client to fill it. As in
+  // XConfigureWindow(), the size leaves out the border, which lies outside it.
+  // Only the windows and fields that differ from the cached geometry are
+  // reconfigured, with one XConfigureWindow each. Updates the cache.
+  void ConfigureFrame(Client* c, const Rect& r);
+  void OnScreenChangeNotify(const XEvent& e);
+  // Re-reads the monitor geometry from RandR into monitors_, and schedules a
+  // relayout of the monitors that changed.
+  void UpdateMonitors();
+  // Returns the index of the monitor containing the given point, or of the
+  // first monitor if no monitor does.
+  size_t MonitorAt(int x, int y) const;
+  // Moves c into the layout of the given monitor.
+  void AssignMonitor(Client* c, size_t monitor);
+  // Returns the layout c is tiled in.
+  Layout& LayoutOf(const Client* c);
+  // Schedules a relayout pass of the given monitor for the end of the current
+  // event batch, so that any number of layout changes within a batch cost a
+  // single pass, and only monitors that changed are reconfigured.
+  void RequestRelayout(size_t monitor);
+  // Schedules a relayout pass of all monitors.
+  void RequestRelayout();
+  // Schedules a relayout pass of the given monitor for when windows have
+  // stopped being mapped and unmapped for config_->relayout_delay
+  // milliseconds, so that a burst of them is tiled with its final geometry in
+  // a single pass.
+  void DeferRelayout(size_t monitor);
+  // Ends the wait of DeferRelayout().
+  void OnRelayoutTimer();
+  // Computes the target rectangle of every window tiled on a monitor with a
+  // pending relayout, and reconfigures the ones that aren't there yet.
+  void Relayout();
+  // The part of the given monitor tiled windows are arranged in.
+  Rect TilingArea(size_t monitor);
   int getBarHeight();
-  int isBar(Window w);
-  struct Tuple getCursor(Display* display);
+  // Classifies w from its _NET_WM_WINDOW_TYPE property. This fetches the
+  // property from the server; use the cached Client::type everywhere else.
+  WindowType ReadWindowType(Window w);
+  // Classifies a window from the atoms in its _NET_WM_WINDOW_TYPE property.
+  WindowType ClassifyWindowType(const Atom* types, size_t n);
+  // Returns whether w lists WM_DELETE_WINDOW in its WM_PROTOCOLS property.
+  // This fetches the property from the server; use the cached
+  // Client::deletable everywhere else.
+  bool ReadDeletable(Window w);
+  // Returns whether the atoms of a WM_PROTOCOLS property include
+  // WM_DELETE_WINDOW.
+  bool HasDeleteProtocol(const Atom* protocols, size_t n);
+  // Kills the client owning w, unless it has closed in the meantime.
+  void OnKillTimeout(Window w);
+  // Disconnects the client owning w, dropping any pending close of w.
+  void KillWindow(Window w);
+  // Returns the pointer position relative to the root window. This is a round
+  // trip, so handlers of events that carry x_root/y_root should use those.
+  Position<int> QueryPointer();
   // Xlib error handler. It must be static as its address is passed to Xlib.
   static int OnXError(Display* display, XErrorEvent* e);
   // Xlib error handler used to determine whether another window manager is
@@ -70,14 +292,133 @@ class WindowManager {
 
   // Handle to the underlying Xlib Display struct.
   Display* display_;
+  // Time and X traffic per event type, handler, key binding and IPC command.
+  // Dumped on SIGUSR1, and queried with the stats IPC command.
+  Stats stats_;
+  // Entries of stats_ for core X event types, indexed by type.
+  StatsEntry* event_stats_[LASTEvent];
+  // Recorder of the session, or nullptr if it isn't recorded.
+  ::std::unique_ptr<EventRecorder> recorder_;
+  // Whether events are dispatched from a recording rather than the display.
+  bool replaying_;
+  // Event loop driving the window manager.
+  EventLoop event_loop_;
+  // Control socket for scripts, served by event_loop_.
+  IpcServer ipc_server_;
   //status bar
   Window bar_;
   // Handle to root window.
   const Window root_;
   int rightWindows_;
   int leftWindows_;
-  // Maps top-level windows to their frame windows.
-  ::std::unordered_map<Window, Window> clients_;
+  // Client records, by top-level window and by frame.
+  ClientTable clients_;
+  // Number of workspaces. Each monitor has a layout per workspace, and one
+  // workspace at a time is shown on all monitors.
+  static const size_t WORKSPACE_COUNT = 9;
+  // An output of the screen, tiled independently of the others.
+  struct Monitor {
+    // Position and size of the monitor relative to the root window.
+    Rect geometry;
+    // Tile order and sizes of the framed windows on the monitor, for each
+    // workspace.
+    Layout layouts[WORKSPACE_COUNT];
+    // Whether the layout of the current workspace or the geometry have changed
+    // since the last relayout pass. Hidden workspaces are never laid out, and
+    // are laid out afresh when they are shown.
+    bool relayout_pending;
+  };
+  // Monitors as reported by RandR, refreshed only on RandR notifications.
+  // There is always at least one.
+  ::std::vector<Monitor> monitors_;
+  // Whether any monitor has a relayout pending.
+  bool relayout_pending_;
+  // Timer ending the wait for a deferred relayout, or -1 if none is deferred.
+  int relayout_timer_;
+  // When the current wait for a deferred relayout started.
+  ::std::chrono::steady_clock::time_point relayout_deferred_since_;
+  // The workspace shown on all monitors.
+  size_t current_workspace_;
+  // Child of the root window advertising EWMH support, or None.
+  Window check_window_;
+  // Framed clients in the order they were framed, as in _NET_CLIENT_LIST.
+  ::std::vector<Window> client_list_;
+  // Number of entries of client_list_ already in _NET_CLIENT_LIST, or -1 if
+  // entries were removed and the property has to be rewritten.
+  int client_list_published_;
+  // The focused client, and the order clients were focused in. Docks never
+  // take part.
+  FocusList focus_;
+  // The client last published as _NET_ACTIVE_WINDOW.
+  Window published_active_window_;
+  // State of the key press whose binding is running, or 0.
+  unsigned int key_press_state_;
+  // The work area last published as _NET_WORKAREA.
+  Rect published_workarea_;
+  // Whether the event loop was stopped to restart the window manager.
+  bool restart_requested_;
+  // First event code of the RandR extension, or -1 if it is unavailable.
+  int randr_event_base_;
+
+  // Signature of key binding actions.
+  typedef void (WindowManager::*KeyActionHandler)(
+      Window w, const ::std::string& arg);
+  // A named action key bindings can refer to.
+  struct KeyAction {
+    const char* name;
+    KeyActionHandler handler;
+    // Whether the action acts on a client, and so does nothing unless the
+    // pointer is over one.
+    bool needs_client;
+  };
+  static const KeyAction KEY_ACTIONS[];
+  // Returns the action with the given name, or nullptr if there is none.
+  static const KeyAction* FindKeyAction(const ::std::string& name);
+  // A key binding resolved to a keycode and handler.
+  struct ResolvedKeyBinding {
+    KeyCode keycode;
+    unsigned int modifiers;
+    KeyActionHandler action;
+    bool needs_client;
+    ::std::string argument;
+    // Entry of stats_ the binding is measured in.
+    StatsEntry* stats;
+  };
+  // Path of the configuration file, and the configuration loaded from it.
+  // Reloading replaces config_ as a whole.
+  const ::std::string config_path_;
+  ::std::shared_ptr<const Config> config_;
+  // inotify instance watching the directory of config_path_, or -1.
+  int inotify_fd_;
+  // Key bindings indexed by KeyTableIndex(), so that a key press is dispatched
+  // with one lookup. Resolved at startup and on keyboard mapping changes.
+  ::std::unordered_map<unsigned int, ResolvedKeyBinding> key_table_;
+  // Modifier mask NumLock is mapped to, which is ignored in key bindings.
+  unsigned int numlock_mask_;
+
+  // The client window being moved or resized, or None.
+  Window drag_window_;
+  // The button that started the move/resize.
+  unsigned int drag_button_;
+  // The latest cursor position during a window move/resize.
+  Position<int> drag_pos_;
+  // Whether drag_pos_ changed since the move/resize was last applied.
+  bool drag_pending_;
+  // Timer applying pointer motion during a move/resize, or -1 while idle.
+  int drag_timer_;
+  // Period of drag_timer_, matching the display's refresh rate.
+  int drag_interval_ms_;
+  // Clients asked to close with WM_DELETE_WINDOW, mapped to the timers that
+  // kill them if they don't.
+  ::std::unordered_map<Window, int> kill_timers_;
+  // Whether the current resize shows an outline and resizes the client only on
+  // release. Latched from config_ when the drag starts.
+  bool outline_resize_;
+  // Whether an outline is currently drawn at outline_rect_.
+  bool outline_visible_;
+  Rect outline_rect_;
+  // XOR graphics context for drawing outlines, created on first use.
+  GC outline_gc_;
 
   // The cursor position at the start of a window move/resize.
   Position<int> drag_start_pos_;
@@ -87,9 +428,30 @@ class WindowManager {
   // The size of the affected window at the start of a window move/resize.
   Size<int> drag_start_frame_size_;
 
-  // Atom constants.
-  const Atom WM_PROTOCOLS;
-  const Atom WM_DELETE_WINDOW;
+  // Atom constants, interned in one XInternAtoms batch by the constructor.
+  // The names are indices into atoms_.
+  enum AtomName {
+    WM_PROTOCOLS,
+    WM_DELETE_WINDOW,
+    NET_WM_WINDOW_TYPE,
+    NET_WM_WINDOW_TYPE_DOCK,
+    NET_WM_WINDOW_TYPE_DESKTOP,
+    BASIC_WM_STATE,
+    NET_NUMBER_OF_DESKTOPS,
+    NET_CURRENT_DESKTOP,
+    NET_DESKTOP_NAMES,
+    UTF8_STRING,
+    NET_SUPPORTED,
+    NET_SUPPORTING_WM_CHECK,
+    NET_WM_NAME,
+    NET_CLIENT_LIST,
+    NET_ACTIVE_WINDOW,
+    NET_WORKAREA,
+    ATOM_COUNT
+  };
+  Atom atoms_[ATOM_COUNT];
+  // The EWMH atoms we support, as listed in _NET_SUPPORTED.
+  static const AtomName SUPPORTED_ATOMS[];
 };
 
 #endif